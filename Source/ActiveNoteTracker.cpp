@@ -0,0 +1,67 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "ActiveNoteTracker.h"
+
+void ActiveNoteTracker::noteOn(int channel, int noteNumber) {
+    if (!isValid(channel, noteNumber)) {
+        return;
+    }
+
+    auto channelIndex = static_cast<size_t>(channel - 1);
+    auto &word = notes[channelIndex][static_cast<size_t>(noteNumber / 64)];
+    auto bit = uint64_t(1) << (noteNumber % 64);
+    if ((word & bit) == 0) {
+        word |= bit;
+        counts[channelIndex]++;
+        channelMask |= uint64_t(1) << channelIndex;
+    }
+}
+
+void ActiveNoteTracker::noteOff(int channel, int noteNumber) {
+    if (!isValid(channel, noteNumber)) {
+        return;
+    }
+
+    auto channelIndex = static_cast<size_t>(channel - 1);
+    auto &word = notes[channelIndex][static_cast<size_t>(noteNumber / 64)];
+    auto bit = uint64_t(1) << (noteNumber % 64);
+    if ((word & bit) != 0) {
+        word &= ~bit;
+        if (--counts[channelIndex] == 0) {
+            channelMask &= ~(uint64_t(1) << channelIndex);
+        }
+    }
+}
+
+void ActiveNoteTracker::clear() {
+    // Only the channels with sounding notes need clearing
+    auto channels = channelMask;
+    while (channels != 0) {
+        auto channelIndex = static_cast<size_t>(BitUtils::countTrailingZeros(channels));
+        channels &= channels - 1;
+
+        notes[channelIndex].fill(0);
+        counts[channelIndex] = 0;
+    }
+
+    channelMask = 0;
+}
+
+bool ActiveNoteTracker::isValid(int channel, int noteNumber) {
+    return channel >= 1 && channel <= NUM_CHANNELS && noteNumber >= 0 && noteNumber < NUM_NOTES;
+}
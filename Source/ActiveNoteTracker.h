@@ -0,0 +1,101 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "util/BitUtils.h"
+
+/**
+ * Tracks the MIDI notes currently sounding on each of the 16 channels.
+ *
+ * Notes are kept in a bitmap with per-channel counts and a mask of non-empty channels, so that iterating over the
+ * sounding notes skips empty channels and scans the rest a word at a time; its cost scales with the number of notes
+ * actually sounding.
+ */
+class ActiveNoteTracker {
+public:
+
+    static constexpr int NUM_CHANNELS = 16;
+    static constexpr int NUM_NOTES = 128;
+
+    /**
+     * Marks the specified note as sounding. Notes or channels out of range are ignored.
+     *
+     * @param channel the MIDI channel, from 1 to 16
+     * @param noteNumber the MIDI note number
+     */
+    void noteOn(int channel, int noteNumber);
+
+    /**
+     * Marks the specified note as not sounding. Notes or channels out of range are ignored.
+     *
+     * @param channel the MIDI channel, from 1 to 16
+     * @param noteNumber the MIDI note number
+     */
+    void noteOff(int channel, int noteNumber);
+
+    /**
+     * Marks all notes as not sounding.
+     */
+    void clear();
+
+    /**
+     * Calls the specified function for each sounding note, ordered by channel and note number.
+     *
+     * @param function the function, taking the channel and the note number
+     */
+    template<typename F>
+    void forEach(F &&function) const {
+        auto channels = channelMask;
+        while (channels != 0) {
+            auto channelIndex = BitUtils::countTrailingZeros(channels);
+            channels &= channels - 1;
+
+            auto &words = notes[static_cast<size_t>(channelIndex)];
+            for (size_t w = 0; w < words.size(); w++) {
+                auto word = words[w];
+                while (word != 0) {
+                    function(channelIndex + 1, static_cast<int>(w * 64) + BitUtils::countTrailingZeros(word));
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+
+private:
+
+    /**
+     * The bitmaps of sounding notes, per channel.
+     */
+    std::array<std::array<uint64_t, NUM_NOTES / 64>, NUM_CHANNELS> notes {};
+
+    /**
+     * The numbers of sounding notes, per channel, keeping `channelMask` up to date.
+     */
+    std::array<int, NUM_CHANNELS> counts {};
+
+    /**
+     * The mask of channels with sounding notes.
+     */
+    uint64_t channelMask = 0;
+
+    static bool isValid(int channel, int noteNumber);
+};
@@ -17,11 +17,20 @@
 
 #include "ArpBuiltEvents.h"
 
-ArpBuiltEvents::EventNoteData ArpBuiltEvents::EventNoteData::of(NoteData& orig) {
-    EventNoteData result;
-    result.noteNumber = orig.noteNumber;
-    result.velocity = orig.velocity;
-    result.pan = orig.pan;
+size_t ArpBuiltEvents::EventNoteData::size() const {
+    return noteNumbers.size();
+}
+
+void ArpBuiltEvents::EventNoteData::reserve(size_t capacity) {
+    noteNumbers.reserve(capacity);
+    velocities.reserve(capacity);
+    pans.reserve(capacity);
+}
 
-    return result;
+uint32_t ArpBuiltEvents::EventNoteData::add(const NoteData &orig) {
+    auto index = static_cast<uint32_t>(size());
+    noteNumbers.push_back(orig.noteNumber);
+    velocities.push_back(orig.velocity);
+    pans.push_back(orig.pan);
+    return index;
 }
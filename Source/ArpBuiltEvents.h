@@ -17,12 +17,19 @@
 
 #pragma once
 
-#include <set>
+#include <cstdint>
+#include <vector>
 
 #include "NoteData.h"
 
 /**
  * A data class of built events of a pattern, ready for playback.
+ *
+ * The events are stored in a flat layout: each event refers to a contiguous range of indices in the `ons` array and
+ * another one in the `offs` array, and the indices point into the struct-of-arrays `data`.
+ *
+ * Built events are immutable once built and may be shared by multiple processors (see `ArpBuiltEventsCache`); the
+ * playback state of each processor is kept separately.
  */
 class ArpBuiltEvents {
 public:
@@ -38,87 +45,123 @@ public:
     };
 
     /**
-     * Data class of a single event in time. Contains the time the event fires (in the set timebase) and indices of
-     * on-data and off-data.
+     * Data class of a single event in time. Contains the time the event fires (in the set timebase) and ranges of
+     * indices of on-data and off-data.
      */
     struct Event {
 
         /**
          * The time in the pattern on which the event fires.
          */
-        int64_t time;
+        int64_t time = 0;
 
         /**
-         * The indices of on-data.
+         * The position of the first index of on-data in `ons`.
          */
-        std::set<size_t> ons;
+        uint32_t onsOffset = 0;
 
         /**
-         * The indices of off-data.
+         * The number of indices of on-data in `ons`.
          */
-        std::set<size_t> offs;
+        uint32_t onsCount = 0;
+
+        /**
+         * The position of the first index of off-data in `offs`.
+         */
+        uint32_t offsOffset = 0;
+
+        /**
+         * The number of indices of off-data in `offs`.
+         */
+        uint32_t offsCount = 0;
     };
 
 
 
     /**
-     * Class of note data in an event.
+     * Struct-of-arrays of note data in the events. All the arrays have the same size.
      */
     struct EventNoteData {
         /**
-         * The index of the note among the input notes.
+         * The indices of the notes among the input notes.
          */
-        int noteNumber = -1;
+        std::vector<int> noteNumbers;
 
         /**
-         * The velocity of the note.
+         * The velocities of the notes.
          */
-        double velocity = 0;
+        std::vector<double> velocities;
 
         /**
-         * The panning of the note.
+         * The panning of the notes.
          */
-        double pan = 0;
+        std::vector<double> pans;
 
 
 
         /**
-         * The last played MIDI note number.
+         * @return the number of notes
          */
-        PlayingNote lastNote = PlayingNote(-1, -1);
-
+        [[nodiscard]] size_t size() const;
 
+        /**
+         * Reserves space for the specified number of notes.
+         */
+        void reserve(size_t capacity);
 
         /**
-         * Creates EventNoteData from NoteData.
+         * Appends the specified note data.
          *
-         * @param orig
-         * @return
+         * @param orig the note data to append
+         * @return the index of the appended data
          */
-        static ArpBuiltEvents::EventNoteData of(NoteData& orig);
+        uint32_t add(const NoteData &orig);
     };
 
 
 
     /**
-     * The event data.
+     * The event data, sorted by time.
      */
     std::vector<Event> events;
 
     /**
-     * The data of notes in the pattern.
+     * The indices of on-data of all events.
      */
-    std::vector<EventNoteData> data;
+    std::vector<uint32_t> ons;
+
+    /**
+     * The indices of off-data of all events.
+     */
+    std::vector<uint32_t> offs;
+
+    /**
+     * The data of notes in the pattern, indexed the same as the notes of the pattern. Notes outside of the loop have
+     * data, but no events.
+     */
+    EventNoteData data;
+
+    /**
+     * The times of the on and the off of each note, indexed the same as `data`, or `-1` for notes outside of the loop.
+     * They let the events of a note be found without walking all events.
+     */
+    std::vector<int64_t> onTimes;
+    std::vector<int64_t> offTimes;
 
 
 
     /**
      * Number of ticks per beat. A tick is the smallest time unit of a pattern.
      */
-    int timebase;
+    int timebase = 0;
+
+    /**
+     * The loop start of the built pattern.
+     */
+    int64_t loopStart = 0;
 
     /**
      * The loop length of the built pattern.
      */
-    int64_t loopLength;
+    int64_t loopLength = 0;
 };
@@ -0,0 +1,184 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "ArpBuiltEventsCache.h"
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+template<typename T>
+static void hashValue(uint64_t &hash, const T &value) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (auto byte : bytes) {
+        hash ^= byte;
+        hash *= FNV_PRIME;
+    }
+}
+
+static void hashValue(uint64_t &hash, double value) {
+    // Equal values must hash equally; -0.0 and 0.0 differ in their bytes
+    hashValue<double>(hash, (value == 0.0) ? 0.0 : value);
+}
+
+
+ArpBuiltEventsCache &ArpBuiltEventsCache::getInstance() {
+    static ArpBuiltEventsCache instance;
+    return instance;
+}
+
+std::shared_ptr<const ArpBuiltEvents> ArpBuiltEventsCache::get(ArpPattern &pattern) {
+    std::scoped_lock patternLock(pattern.getMutex());
+
+    auto patternHash = hash(pattern);
+
+    {
+        std::scoped_lock lock(mutex);
+        if (auto events = find(pattern, patternHash)) {
+            return events;
+        }
+    }
+
+    // Built without holding the lock, so that processors building different patterns do not wait for each other
+    std::shared_ptr<const ArpBuiltEvents> built = std::make_shared<ArpBuiltEvents>(pattern.buildEvents());
+
+    std::scoped_lock lock(mutex);
+    if (auto events = find(pattern, patternHash)) {
+        // An identical pattern has been built in the meantime
+        return events;
+    }
+
+    if (entries.size() >= purgeThreshold) {
+        purge();
+        purgeThreshold = std::max(MIN_PURGE_THRESHOLD, entries.size() * 2);
+    }
+    entries.emplace(patternHash, built);
+    return built;
+}
+
+size_t ArpBuiltEventsCache::size() {
+    std::scoped_lock lock(mutex);
+    purge();
+    return entries.size();
+}
+
+std::shared_ptr<const ArpBuiltEvents> ArpBuiltEventsCache::find(ArpPattern &pattern, uint64_t patternHash) {
+    auto range = entries.equal_range(patternHash);
+    for (auto it = range.first; it != range.second; it++) {
+        if (auto events = it->second.lock()) {
+            if (matches(pattern, *events)) {
+                return events;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void ArpBuiltEventsCache::purge() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.expired()) {
+            it = entries.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+uint64_t ArpBuiltEventsCache::hash(ArpPattern &pattern) {
+    uint64_t result = FNV_OFFSET_BASIS;
+    hashValue(result, pattern.getTimebase());
+    hashValue(result, pattern.loopStart);
+    hashValue(result, pattern.loopEnd);
+    for (auto &note : pattern.getNotes()) {
+        hashValue(result, note.startPoint);
+        hashValue(result, note.endPoint);
+        hashValue(result, note.data.noteNumber);
+        hashValue(result, note.data.velocity);
+        hashValue(result, note.data.pan);
+    }
+    return result;
+}
+
+bool ArpBuiltEventsCache::matches(ArpPattern &pattern, const ArpBuiltEvents &events) {
+    auto &notes = pattern.getNotes();
+    auto loopLength = pattern.loopEnd - pattern.loopStart;
+    if (events.timebase != pattern.getTimebase()
+            || events.loopStart != pattern.loopStart
+            || events.loopLength != loopLength
+            || events.data.size() != notes.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < notes.size(); i++) {
+        auto &data = notes[i].data;
+        if (events.data.noteNumbers[i] != data.noteNumber
+                || events.data.velocities[i] != data.velocity
+                || events.data.pans[i] != data.pan) {
+            return false;
+        }
+    }
+
+    // Like in `ArpPattern::buildEvents()`, each note inside of the loop has an on at its start, an off at its end and
+    // an off at zero (the same one if it ends at the loop end); notes outside of the loop have no events
+    std::vector<uint8_t> numOns(notes.size(), 0);
+    std::vector<uint8_t> offMasks(notes.size(), 0);
+    auto isInLoop = [&](const ArpNote &note) {
+        return loopLength > 0 && note.startPoint >= pattern.loopStart && note.endPoint <= pattern.loopEnd;
+    };
+
+    for (auto &event : events.events) {
+        for (auto o = event.onsOffset; o < event.onsOffset + event.onsCount; o++) {
+            auto i = events.ons[o];
+            auto &note = notes[i];
+            if (!isInLoop(note)
+                    || (note.startPoint - pattern.loopStart) % loopLength != event.time
+                    || numOns[i]++ != 0) {
+                return false;
+            }
+        }
+        for (auto o = event.offsOffset; o < event.offsOffset + event.offsCount; o++) {
+            auto i = events.offs[o];
+            auto &note = notes[i];
+            if (!isInLoop(note)) {
+                return false;
+            }
+
+            uint8_t offMask = (event.time == 0) ? 1 : 2;
+            if ((offMask == 2 && (note.endPoint - pattern.loopStart) % loopLength != event.time)
+                    || (offMasks[i] & offMask) != 0) {
+                return false;
+            }
+            offMasks[i] |= offMask;
+        }
+    }
+
+    for (size_t i = 0; i < notes.size(); i++) {
+        auto &note = notes[i];
+        if (!isInLoop(note)) {
+            continue; // No events have been counted for it
+        }
+
+        uint8_t expectedOffMask = ((note.endPoint - pattern.loopStart) % loopLength == 0) ? 1 : 3;
+        if (numOns[i] != 1 || offMasks[i] != expectedOffMask) {
+            return false;
+        }
+    }
+
+    return true;
+}
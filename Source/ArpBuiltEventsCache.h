@@ -0,0 +1,93 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "ArpBuiltEvents.h"
+#include "ArpPattern.h"
+
+/**
+ * A process-wide cache of built events, shared by all processors playing an identical pattern. Patterns are looked up
+ * by their content; the built events are immutable and only kept alive for as long as a processor uses them.
+ */
+class ArpBuiltEventsCache {
+public:
+
+    /**
+     * @return the process-wide instance of the cache
+     */
+    static ArpBuiltEventsCache &getInstance();
+
+    /**
+     * Gets the built events of the specified pattern, building them only if no identical pattern is currently built.
+     *
+     * @param pattern the pattern to get the built events of
+     * @return the built events of the pattern
+     */
+    std::shared_ptr<const ArpBuiltEvents> get(ArpPattern &pattern);
+
+    /**
+     * @return the number of built events currently alive in the cache
+     */
+    size_t size();
+
+private:
+
+    /**
+     * The number of entries below which unused entries are not purged.
+     */
+    static constexpr size_t MIN_PURGE_THRESHOLD = 64;
+
+    std::mutex mutex;
+
+    /**
+     * The built events by the hash of the pattern they were built from. Only the hash is kept of the pattern; a
+     * candidate is compared against the built events themselves (see `matches()`).
+     */
+    std::unordered_multimap<uint64_t, std::weak_ptr<const ArpBuiltEvents>> entries;
+
+    /**
+     * The number of entries at which unused entries are purged next, so that purging is amortized over insertions.
+     */
+    size_t purgeThreshold = MIN_PURGE_THRESHOLD;
+
+    ArpBuiltEventsCache() = default;
+
+    /**
+     * Looks up live built events matching the specified pattern. Must be called with the mutex held.
+     */
+    std::shared_ptr<const ArpBuiltEvents> find(ArpPattern &pattern, uint64_t hash);
+
+    /**
+     * Removes entries whose built events are no longer used. Must be called with the mutex held.
+     */
+    void purge();
+
+    /**
+     * @return a hash of the content of the specified pattern that determines its built events
+     */
+    static uint64_t hash(ArpPattern &pattern);
+
+    /**
+     * Checks whether the specified built events are exactly those the specified pattern builds, without building it.
+     */
+    static bool matches(ArpPattern &pattern, const ArpBuiltEvents &events);
+};
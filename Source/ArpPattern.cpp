@@ -15,8 +15,12 @@
 // along with this program.  If not, see https://librearp.gitlab.io/license/.
 //
 
-#include <map>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
 #include "ArpPattern.h"
+#include "util/XmlPullParser.h"
 
 const juce::Identifier ArpPattern::TREEID_PATTERN = juce::Identifier("pattern"); // NOLINT
 const juce::Identifier ArpPattern::TREEID_TIMEBASE = juce::Identifier("timebase"); // NOLINT
@@ -25,6 +29,17 @@ const juce::Identifier ArpPattern::TREEID_LOOP_START = juce::Identifier("loopSta
 const juce::Identifier ArpPattern::TREEID_LOOP_END = juce::Identifier("loopEnd"); // NOLINT
 const juce::Identifier ArpPattern::TREEID_NOTES = juce::Identifier("notes"); // NOLINT
 
+/**
+ * The size of a note record written by `toStream()` - the start and end points, the note number, the velocity and the
+ * pan.
+ */
+static const int STREAM_NOTE_SIZE = 8 + 8 + 4 + 8 + 8;
+
+/**
+ * The line separator used in XML documents written by `toXmlStream()`, the same as in juce::XmlElement.
+ */
+static const char *const XML_NEW_LINE = "\r\n";
+
 ArpPattern::ArpPattern(int timebase) : loopEnd(timebase), timebase(timebase) {}
 
 ArpPattern::ArpPattern(ArpPattern &pattern) {
@@ -49,44 +64,347 @@ std::vector<ArpNote> &ArpPattern::getNotes() {
 }
 
 
+namespace {
+    /**
+     * A single on or off of a note, to be sorted into events.
+     */
+    struct BuildEntry {
+        int64_t time;
+        bool on;
+        uint32_t dataIndex;
+
+        bool operator<(const BuildEntry &other) const {
+            return std::tie(time, on, dataIndex) < std::tie(other.time, other.on, other.dataIndex);
+        }
+
+        bool operator==(const BuildEntry &other) const {
+            return time == other.time && on == other.on && dataIndex == other.dataIndex;
+        }
+    };
+
+    /**
+     * Gets the times of the on and the off of the specified note within the loop. The off of a note ending at the loop
+     * end is at zero.
+     *
+     * @return `false` if the note starts or ends outside of the loop, in which case it has no events and the times are
+     * set to `-1`
+     */
+    bool getEntryTimes(const ArpNote &note, int64_t loopStart, int64_t loopEnd, int64_t &onTime, int64_t &offTime) {
+        auto loopLength = loopEnd - loopStart;
+        if (loopLength <= 0 || note.startPoint < loopStart || note.endPoint > loopEnd) {
+            onTime = -1;
+            offTime = -1;
+            return false;
+        }
+
+        onTime = (note.startPoint - loopStart) % loopLength;
+        offTime = (note.endPoint - loopStart) % loopLength;
+        return true;
+    }
+
+    /**
+     * Adds the entries of a note with the specified times.
+     */
+    void addEntries(std::vector<BuildEntry> &entries, uint32_t dataIndex, int64_t onTime, int64_t offTime) {
+        entries.push_back({ onTime, true, dataIndex });
+        entries.push_back({ offTime, false, dataIndex });
+        entries.push_back({ 0, false, dataIndex }); // Total off
+    }
+
+    /**
+     * Sorts the specified entries. Offs come before ons in each event, both ordered by the data index; duplicates
+     * (notes ending at the loop end, and thus at zero) are removed.
+     */
+    void sortEntries(std::vector<BuildEntry> &entries) {
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    }
+
+    /**
+     * Appends the specified entry to the events. Entries must be appended in sorted order.
+     */
+    void appendEntry(ArpBuiltEvents &result, const BuildEntry &entry) {
+        if (result.events.empty() || result.events.back().time != entry.time) {
+            ArpBuiltEvents::Event event;
+            event.time = entry.time;
+            event.onsOffset = static_cast<uint32_t>(result.ons.size());
+            event.offsOffset = static_cast<uint32_t>(result.offs.size());
+            result.events.push_back(event);
+        }
+
+        auto &event = result.events.back();
+        if (entry.on) {
+            result.ons.push_back(entry.dataIndex);
+            event.onsCount++;
+        } else {
+            result.offs.push_back(entry.dataIndex);
+            event.offsCount++;
+        }
+    }
+
+    /**
+     * Appends the specified consecutive events of previously built events, along with their indices of on- and
+     * off-data.
+     */
+    void copyEvents(ArpBuiltEvents &result, const ArpBuiltEvents &previous,
+                    std::vector<ArpBuiltEvents::Event>::const_iterator first,
+                    std::vector<ArpBuiltEvents::Event>::const_iterator last) {
+        if (first == last) {
+            return;
+        }
+
+        // The indices of consecutive events are contiguous, so they are copied as a whole and only the offsets shift
+        auto &lastEvent = *(last - 1);
+        auto onsShift = static_cast<uint32_t>(result.ons.size()) - first->onsOffset;
+        auto offsShift = static_cast<uint32_t>(result.offs.size()) - first->offsOffset;
+        result.ons.insert(result.ons.end(),
+                          previous.ons.data() + first->onsOffset,
+                          previous.ons.data() + lastEvent.onsOffset + lastEvent.onsCount);
+        result.offs.insert(result.offs.end(),
+                           previous.offs.data() + first->offsOffset,
+                           previous.offs.data() + lastEvent.offsOffset + lastEvent.offsCount);
+
+        for (auto event = first; event != last; ++event) {
+            auto &copy = result.events.emplace_back(*event);
+            copy.onsOffset += onsShift;
+            copy.offsOffset += offsShift;
+        }
+    }
+
+    /**
+     * Appends the indices of a previously built event that do not belong to changed notes, merged in order with the
+     * indices of the specified entries.
+     *
+     * @return the number of appended indices
+     */
+    template<typename IsChanged>
+    uint32_t mergeIndices(std::vector<uint32_t> &result, const uint32_t *previous, const uint32_t *previousEnd,
+                          std::vector<BuildEntry>::const_iterator &entry,
+                          std::vector<BuildEntry>::const_iterator entriesEnd,
+                          IsChanged isChanged) {
+        auto size = result.size();
+        while (previous != previousEnd || entry != entriesEnd) {
+            if (previous != previousEnd && isChanged(*previous)) {
+                previous++;
+            } else if (entry == entriesEnd || (previous != previousEnd && *previous < entry->dataIndex)) {
+                result.push_back(*previous++);
+            } else {
+                result.push_back((entry++)->dataIndex);
+            }
+        }
+        return static_cast<uint32_t>(result.size() - size);
+    }
+}
+
 ArpBuiltEvents ArpPattern::buildEvents() {
     std::scoped_lock lock(mutex);
-    std::map<int64_t, ArpBuiltEvents::Event> eventMap;
+
+    std::vector<BuildEntry> entries;
+    entries.reserve(this->notes.size() * 3);
     ArpBuiltEvents result;
 
     result.timebase = this->timebase;
+    result.loopStart = this->loopStart;
     result.loopLength = this->loopEnd - this->loopStart;
+    result.data.reserve(this->notes.size());
+    result.onTimes.resize(this->notes.size());
+    result.offTimes.resize(this->notes.size());
 
     for (auto &note : this->notes) {
-        if (note.startPoint < this->loopStart || note.endPoint > this->loopEnd) {
-            continue; // Skip notes whose starts or ends are outside the loop
+        auto dataIndex = result.data.add(note.data);
+        auto &onTime = result.onTimes[dataIndex];
+        auto &offTime = result.offTimes[dataIndex];
+        if (getEntryTimes(note, this->loopStart, this->loopEnd, onTime, offTime)) {
+            addEntries(entries, dataIndex, onTime, offTime);
         }
+    }
 
-        auto dataIndex = result.data.size();
-        result.data.push_back(ArpBuiltEvents::EventNoteData::of(note.data));
+    sortEntries(entries);
 
-        int64_t onTime = (note.startPoint - this->loopStart) % result.loopLength;
-        ArpBuiltEvents::Event &onEvent = eventMap[onTime];
-        onEvent.time = onTime;
-        onEvent.ons.insert(dataIndex);
+    result.ons.reserve(result.data.size());
+    result.offs.reserve(entries.size());
+    for (const auto &entry : entries) {
+        appendEntry(result, entry);
+    }
 
-        int64_t offTime = (note.endPoint - this->loopStart) % result.loopLength;
-        ArpBuiltEvents::Event &offEvent = eventMap[offTime];
-        offEvent.time = offTime;
-        offEvent.offs.insert(dataIndex);
+    return result;
+}
+
+ArpBuiltEvents ArpPattern::buildEvents(const ArpBuiltEvents &previous, const std::vector<size_t> &changedNotes) {
+    std::scoped_lock lock(mutex);
+
+    if (!isPatchableFrom(previous)) {
+        return buildEvents();
+    }
+
+    // The changed notes that have been built before, sorted, followed by the appended ones
+    auto numPreviousNotes = previous.data.size();
+    std::vector<uint32_t> changed;
+    changed.reserve(changedNotes.size() + this->notes.size() - numPreviousNotes);
+    for (auto index : changedNotes) {
+        jassert(index < this->notes.size()); // Removing notes needs a full build
+        if (index < numPreviousNotes) {
+            changed.push_back(static_cast<uint32_t>(index));
+        }
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    auto changedPreviousEnd = static_cast<std::ptrdiff_t>(changed.size());
+    for (auto i = numPreviousNotes; i < this->notes.size(); i++) {
+        changed.push_back(static_cast<uint32_t>(i));
+    }
 
-        ArpBuiltEvents::Event &totalOffEvent = eventMap[0];
-        totalOffEvent.time = 0;
-        totalOffEvent.offs.insert(dataIndex);
+    auto isChanged = [&](uint32_t index) {
+        return index >= numPreviousNotes
+                || std::binary_search(changed.begin(), changed.begin() + changedPreviousEnd, index);
+    };
+
+#if JUCE_DEBUG
+    // Notes not reported as changed must be the same as when the previous events were built. This takes a pass over
+    // all notes, so it is only checked in debug builds.
+    for (uint32_t i = 0; i < numPreviousNotes; i++) {
+        int64_t onTime;
+        int64_t offTime;
+        getEntryTimes(this->notes[i], this->loopStart, this->loopEnd, onTime, offTime);
+        auto &data = this->notes[i].data;
+        jassert(isChanged(i) || (previous.data.noteNumbers[i] == data.noteNumber
+                                 && previous.data.velocities[i] == data.velocity
+                                 && previous.data.pans[i] == data.pan
+                                 && previous.onTimes[i] == onTime
+                                 && previous.offTimes[i] == offTime));
     }
+#endif
+
+    ArpBuiltEvents result;
+    result.timebase = previous.timebase;
+    result.loopStart = previous.loopStart;
+    result.loopLength = previous.loopLength;
+    result.data = previous.data;
+    result.onTimes = previous.onTimes;
+    result.offTimes = previous.offTimes;
+    result.data.reserve(this->notes.size());
+    result.onTimes.resize(this->notes.size(), -1);
+    result.offTimes.resize(this->notes.size(), -1);
+
+    // Only the events at the previous and the new times of the changed notes are rebuilt, and only the entries of the
+    // changed notes are sorted
+    std::vector<int64_t> touchedTimes;
+    std::vector<BuildEntry> entries;
+    for (auto index : changed) {
+        auto &note = this->notes[index];
+        if (index < numPreviousNotes) {
+            if (previous.onTimes[index] >= 0) {
+                touchedTimes.insert(touchedTimes.end(), { previous.onTimes[index], previous.offTimes[index], 0 });
+            }
+            result.data.noteNumbers[index] = note.data.noteNumber;
+            result.data.velocities[index] = note.data.velocity;
+            result.data.pans[index] = note.data.pan;
+        } else {
+            result.data.add(note.data);
+        }
 
-    for (const auto &pair : eventMap) {
-        result.events.push_back(pair.second);
+        auto &onTime = result.onTimes[index];
+        auto &offTime = result.offTimes[index];
+        if (getEntryTimes(note, this->loopStart, this->loopEnd, onTime, offTime)) {
+            addEntries(entries, index, onTime, offTime);
+            touchedTimes.insert(touchedTimes.end(), { onTime, offTime, 0 });
+        }
     }
+    sortEntries(entries);
+    std::sort(touchedTimes.begin(), touchedTimes.end());
+    touchedTimes.erase(std::unique(touchedTimes.begin(), touchedTimes.end()), touchedTimes.end());
+
+    result.events.reserve(previous.events.size() + entries.size());
+    result.ons.reserve(previous.ons.size() + entries.size());
+    result.offs.reserve(previous.offs.size() + entries.size());
+
+    auto previousEvent = previous.events.cbegin();
+    auto nextEntry = entries.cbegin();
+    for (auto time : touchedTimes) {
+        // The events in between are not affected by the changes
+        auto touchedEvent = std::lower_bound(
+                previousEvent, previous.events.cend(), time,
+                [](const ArpBuiltEvents::Event &event, int64_t t) { return event.time < t; });
+        copyEvents(result, previous, previousEvent, touchedEvent);
+        previousEvent = touchedEvent;
+
+        const uint32_t *previousOffs = nullptr;
+        const uint32_t *previousOffsEnd = nullptr;
+        const uint32_t *previousOns = nullptr;
+        const uint32_t *previousOnsEnd = nullptr;
+        if (previousEvent != previous.events.cend() && previousEvent->time == time) {
+            previousOffs = previous.offs.data() + previousEvent->offsOffset;
+            previousOffsEnd = previousOffs + previousEvent->offsCount;
+            previousOns = previous.ons.data() + previousEvent->onsOffset;
+            previousOnsEnd = previousOns + previousEvent->onsCount;
+            ++previousEvent;
+        }
+
+        // The entries at this time - offs come before ons
+        auto offsEnd = nextEntry;
+        while (offsEnd != entries.cend() && offsEnd->time == time && !offsEnd->on) {
+            ++offsEnd;
+        }
+        auto onsEnd = offsEnd;
+        while (onsEnd != entries.cend() && onsEnd->time == time) {
+            ++onsEnd;
+        }
+
+        ArpBuiltEvents::Event event;
+        event.time = time;
+        event.offsOffset = static_cast<uint32_t>(result.offs.size());
+        event.onsOffset = static_cast<uint32_t>(result.ons.size());
+        event.offsCount = mergeIndices(result.offs, previousOffs, previousOffsEnd, nextEntry, offsEnd, isChanged);
+        event.onsCount = mergeIndices(result.ons, previousOns, previousOnsEnd, nextEntry, onsEnd, isChanged);
+        if (event.offsCount > 0 || event.onsCount > 0) {
+            result.events.push_back(event);
+        }
+    }
+    copyEvents(result, previous, previousEvent, previous.events.cend());
+    jassert(nextEntry == entries.cend());
 
     return result;
 }
 
+bool ArpPattern::isPatchableFrom(const ArpBuiltEvents &previous) {
+    std::scoped_lock lock(mutex);
+    return previous.timebase == this->timebase
+            && previous.loopStart == this->loopStart
+            && previous.loopLength == this->loopEnd - this->loopStart
+            && previous.loopLength > 0
+            && previous.data.size() <= this->notes.size()
+            && previous.onTimes.size() == previous.data.size();
+}
+
+namespace {
+    void writeXmlAttribute(juce::OutputStream &out, const juce::Identifier &name, juce::int64 value) {
+        out << " " << name.toString() << "=\"" << value << "\"";
+    }
+
+    void writeXmlAttribute(juce::OutputStream &out, const juce::Identifier &name, double value) {
+        // Formatted the same way as in value trees
+        out << " " << name.toString() << "=\"" << juce::var(value).toString() << "\"";
+    }
+
+    bool hasXmlName(const XmlPullParser &parser, const juce::Identifier &name) {
+        return std::strcmp(parser.getName().c_str(), name.toString().toRawUTF8()) == 0;
+    }
+
+    template<typename T>
+    void readXmlAttribute(const XmlPullParser &parser, const juce::Identifier &name, T &value) {
+        auto text = parser.getAttribute(name.toString().toRawUTF8());
+        if (text == nullptr) {
+            return;
+        }
+
+        if constexpr (std::is_floating_point_v<T>) {
+            value = static_cast<T>(juce::CharacterFunctions::getDoubleValue(juce::CharPointer_UTF8(text)));
+        } else {
+            value = static_cast<T>(juce::CharacterFunctions::getIntValue<juce::int64>(juce::CharPointer_UTF8(text)));
+        }
+    }
+}
+
 juce::ValueTree ArpPattern::toValueTree() {
     std::scoped_lock lock(mutex);
     juce::ValueTree result = juce::ValueTree(TREEID_PATTERN);
@@ -103,9 +421,70 @@ juce::ValueTree ArpPattern::toValueTree() {
     return result;
 }
 
+void ArpPattern::toXmlStream(juce::OutputStream &out) {
+    std::scoped_lock lock(mutex);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << XML_NEW_LINE << XML_NEW_LINE;
+
+    out << "<" << TREEID_PATTERN.toString();
+    writeXmlAttribute(out, TREEID_TIMEBASE, juce::int64(this->timebase));
+    writeXmlAttribute(out, TREEID_LOOP_START, juce::int64(this->loopStart));
+    writeXmlAttribute(out, TREEID_LOOP_END, juce::int64(this->loopEnd));
+    out << ">" << XML_NEW_LINE;
+
+    if (this->notes.empty()) {
+        out << "  <" << TREEID_NOTES.toString() << "/>" << XML_NEW_LINE;
+    } else {
+        out << "  <" << TREEID_NOTES.toString() << ">" << XML_NEW_LINE;
+        for (auto &note : this->notes) {
+            out << "    <" << ArpNote::TREEID_NOTE.toString();
+            writeXmlAttribute(out, ArpNote::TREEID_START_POINT, juce::int64(note.startPoint));
+            writeXmlAttribute(out, ArpNote::TREEID_END_POINT, juce::int64(note.endPoint));
+            out << ">" << XML_NEW_LINE;
+
+            out << "      <" << NoteData::TREEID_NOTE_DATA.toString();
+            writeXmlAttribute(out, NoteData::TREEID_NOTE_NUMBER, juce::int64(note.data.noteNumber));
+            writeXmlAttribute(out, NoteData::TREEID_VELOCITY, note.data.velocity);
+            writeXmlAttribute(out, NoteData::TREEID_PAN, note.data.pan);
+            out << "/>" << XML_NEW_LINE;
+
+            out << "    </" << ArpNote::TREEID_NOTE.toString() << ">" << XML_NEW_LINE;
+        }
+        out << "  </" << TREEID_NOTES.toString() << ">" << XML_NEW_LINE;
+    }
+
+    out << "</" << TREEID_PATTERN.toString() << ">" << XML_NEW_LINE;
+}
+
 void ArpPattern::toFile(const juce::File &file) {
-    auto tree = toValueTree();
-    file.replaceWithText(tree.toXmlString());
+    juce::TemporaryFile tempFile(file);
+    {
+        juce::FileOutputStream out(tempFile.getFile());
+        if (!out.openedOk()) {
+            return;
+        }
+        toXmlStream(out);
+        out.flush();
+        if (out.getStatus().failed()) {
+            return;
+        }
+    }
+    tempFile.overwriteTargetFileWithTemporary();
+}
+
+void ArpPattern::toStream(juce::OutputStream &out) {
+    std::scoped_lock lock(mutex);
+    out.writeInt(this->timebase);
+    out.writeInt64(this->loopStart);
+    out.writeInt64(this->loopEnd);
+    out.writeInt(STREAM_NOTE_SIZE);
+    out.writeInt(static_cast<int>(this->notes.size()));
+    for (auto &note : this->notes) {
+        out.writeInt64(note.startPoint);
+        out.writeInt64(note.endPoint);
+        out.writeInt(note.data.noteNumber);
+        out.writeDouble(note.data.velocity);
+        out.writeDouble(note.data.pan);
+    }
 }
 
 int64_t ArpPattern::loopLength() const {
@@ -148,10 +527,155 @@ ArpPattern ArpPattern::fromValueTree(juce::ValueTree &tree) {
     return result;
 }
 
-ArpPattern ArpPattern::fromFile(const juce::File &file) {
-    auto xmlDoc = juce::XmlDocument::parse(file);
-    auto tree = juce::ValueTree::fromXml(*xmlDoc);
-    return fromValueTree(tree);
+ArpPattern ArpPattern::fromStream(juce::InputStream &in) {
+    auto timebase = in.readInt();
+    auto loopStart = in.readInt64();
+    auto loopEnd = in.readInt64();
+    auto noteSize = in.readInt();
+    auto numNotes = in.readInt();
+
+    auto remaining = in.getNumBytesRemaining();
+    if (timebase <= 0
+            || noteSize < STREAM_NOTE_SIZE
+            || numNotes < 0
+            || (remaining >= 0 && static_cast<juce::int64>(numNotes) * noteSize > remaining)) {
+        return ArpPattern();
+    }
+
+    ArpPattern result = ArpPattern(timebase);
+    result.loopStart = loopStart;
+    result.loopEnd = loopEnd;
+    result.notes.resize(static_cast<size_t>(numNotes));
+    for (auto &note : result.notes) {
+        note.startPoint = in.readInt64();
+        note.endPoint = in.readInt64();
+        note.data.noteNumber = in.readInt();
+        note.data.velocity = in.readDouble();
+        note.data.pan = in.readDouble();
+        if (noteSize > STREAM_NOTE_SIZE) {
+            in.skipNextBytes(noteSize - STREAM_NOTE_SIZE);
+        }
+    }
+
+    return result;
+}
+
+ArpPattern ArpPattern::fromXmlStream(juce::InputStream &in, bool *outSuccess) {
+    using Event = XmlPullParser::Event;
+    XmlPullParser parser(in);
+    if (outSuccess != nullptr) {
+        *outSuccess = false;
+    }
+
+    if (parser.next() != Event::START_ELEMENT) {
+        return ArpPattern();
+    }
+
+    int timebase = DEFAULT_TIMEBASE;
+    readXmlAttribute(parser, TREEID_TIMEBASE, timebase);
+
+    ArpPattern result = ArpPattern(timebase);
+
+    if (!hasXmlName(parser, TREEID_PATTERN)) {
+        return result;
+    }
+
+    if (parser.getAttribute(TREEID_LOOP_LENGTH.toString().toRawUTF8()) != nullptr) {
+        // Compatibility with old versions that do not have the loop start/end range
+        result.loopStart = 0;
+        readXmlAttribute(parser, TREEID_LOOP_LENGTH, result.loopEnd);
+    }
+    readXmlAttribute(parser, TREEID_LOOP_START, result.loopStart);
+    readXmlAttribute(parser, TREEID_LOOP_END, result.loopEnd);
+
+    // Like in `fromValueTree()`, only the first notes element and the first data element of each note are read
+    bool hadNotes = false;
+    bool inNotes = false;
+    bool inNote = false;
+    bool hadNoteData = false;
+    while (true) {
+        switch (parser.next()) {
+            case Event::START_ELEMENT:
+                if (parser.getDepth() == 2 && !hadNotes && hasXmlName(parser, TREEID_NOTES)) {
+                    hadNotes = true;
+                    inNotes = true;
+                } else if (parser.getDepth() == 3 && inNotes) {
+                    if (!hasXmlName(parser, ArpNote::TREEID_NOTE)) {
+                        return ArpPattern();
+                    }
+
+                    auto &note = result.notes.emplace_back();
+                    readXmlAttribute(parser, ArpNote::TREEID_START_POINT, note.startPoint);
+                    readXmlAttribute(parser, ArpNote::TREEID_END_POINT, note.endPoint);
+                    inNote = true;
+                    hadNoteData = false;
+                } else if (parser.getDepth() == 4 && inNote && !hadNoteData
+                        && hasXmlName(parser, NoteData::TREEID_NOTE_DATA)) {
+                    auto &data = result.notes.back().data;
+                    readXmlAttribute(parser, NoteData::TREEID_NOTE_NUMBER, data.noteNumber);
+                    readXmlAttribute(parser, NoteData::TREEID_VELOCITY, data.velocity);
+                    readXmlAttribute(parser, NoteData::TREEID_PAN, data.pan);
+                    hadNoteData = true;
+                }
+                break;
+
+            case Event::END_ELEMENT:
+                if (parser.getDepth() == 1) {
+                    if (outSuccess != nullptr) {
+                        *outSuccess = true;
+                    }
+                    return result;
+                } else if (parser.getDepth() == 2) {
+                    inNotes = false;
+                } else if (parser.getDepth() == 3) {
+                    inNote = false;
+                }
+                break;
+
+            default:
+                return ArpPattern(); // Malformed or truncated document
+        }
+    }
+}
+
+ArpPattern ArpPattern::fromFile(const juce::File &file, bool *outSuccess) {
+    juce::FileInputStream in(file);
+    if (!in.openedOk()) {
+        if (outSuccess != nullptr) {
+            *outSuccess = false;
+        }
+        return ArpPattern();
+    }
+    return fromXmlStream(in, outSuccess);
+}
+
+
+void ArpPattern::notesChanged() {
+    std::scoped_lock lock(mutex);
+    this->noteIndex.invalidate();
+}
+
+void ArpPattern::notesChanged(const std::vector<size_t> &changedNotes) {
+    std::scoped_lock lock(mutex);
+    if (this->noteIndex.isValid()) {
+        this->noteIndex.update(this->notes, changedNotes);
+    }
+}
+
+void ArpPattern::findNotes(int64_t from, int64_t to, std::vector<size_t> &result) {
+    std::scoped_lock lock(mutex);
+    if (!this->noteIndex.isValid()) {
+        this->noteIndex.rebuild(this->notes);
+    }
+    this->noteIndex.findOverlapping(from, to, result);
+}
+
+bool ArpPattern::getNotesBounds(int64_t &outStart, int64_t &outEnd, int &outMinNoteNumber, int &outMaxNoteNumber) {
+    std::scoped_lock lock(mutex);
+    if (!this->noteIndex.isValid()) {
+        this->noteIndex.rebuild(this->notes);
+    }
+    return this->noteIndex.getBounds(outStart, outEnd, outMinNoteNumber, outMaxNoteNumber);
 }
 
 
@@ -165,5 +689,6 @@ ArpPattern& ArpPattern::operator=(const ArpPattern &pattern) noexcept {
     this->loopStart = pattern.loopStart;
     this->loopEnd = pattern.loopEnd;
     this->notes = pattern.notes;
+    this->noteIndex.invalidate();
     return *this;
 }
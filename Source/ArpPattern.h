@@ -23,6 +23,7 @@
 
 #include "ArpNote.h"
 #include "ArpBuiltEvents.h"
+#include "NoteIntervalIndex.h"
 
 /**
  * A data class of a pattern, editable by the user.
@@ -84,6 +85,62 @@ public:
      */
     ArpBuiltEvents buildEvents();
 
+    /**
+     * Builds events from this pattern by patching events previously built from it, after some of its notes have been
+     * changed or new notes have been appended. Only the events at the previous and the new times of the changed notes
+     * are rebuilt; the others are copied over as a whole. Falls back to a full build if the previous events cannot be
+     * patched (see `isPatchableFrom()`).
+     *
+     * All notes not listed as changed must be the same as when the previous events were built; debug builds check
+     * this.
+     *
+     * @param previous events previously built from this pattern
+     * @param changedNotes the indices of the changed notes; appended notes do not need to be listed
+     * @return ArpBuiltEvents built from this pattern
+     */
+    ArpBuiltEvents buildEvents(const ArpBuiltEvents &previous, const std::vector<size_t> &changedNotes);
+
+    /**
+     * Checks whether the specified events, previously built from this pattern, can be patched by
+     * `buildEvents(previous, changedNotes)`. This is the case when the timebase and the loop have stayed the same and
+     * no notes have been removed.
+     *
+     * @param previous events previously built from this pattern
+     * @return whether the events can be patched
+     */
+    bool isPatchableFrom(const ArpBuiltEvents &previous);
+
+
+    /**
+     * Notifies the pattern that its notes have been changed in an arbitrary way (including removals), so that its
+     * note index is rebuilt on next use.
+     */
+    void notesChanged();
+
+    /**
+     * Notifies the pattern that the specified notes have been changed, or that notes have been appended. No notes
+     * may have been removed.
+     *
+     * @param changedNotes the indices of the changed notes
+     */
+    void notesChanged(const std::vector<size_t> &changedNotes);
+
+    /**
+     * Finds the notes overlapping the specified range of pulses.
+     *
+     * @param from the start of the range, in pulses
+     * @param to the end of the range, in pulses
+     * @param result the vector the indices of the found notes are written into, in ascending order
+     */
+    void findNotes(int64_t from, int64_t to, std::vector<size_t> &result);
+
+    /**
+     * Gets the extent of all notes of this pattern.
+     *
+     * @return `false` if the pattern has no notes, in which case the output variables are left untouched
+     */
+    bool getNotesBounds(int64_t &outStart, int64_t &outEnd, int &outMinNoteNumber, int &outMaxNoteNumber);
+
 
     /**
      * Gets this pattern's mutex.
@@ -100,6 +157,14 @@ public:
      */
     juce::ValueTree toValueTree();
 
+    /**
+     * Serializes this pattern into the specified stream as an XML document, in the same schema as `toValueTree()`.
+     * Notes are written one by one, without building the tree in memory.
+     *
+     * @param out the stream to write into
+     */
+    void toXmlStream(juce::OutputStream &out);
+
     /**
      * Serializes this pattern and saves it to the specified file.
      *
@@ -107,6 +172,15 @@ public:
      */
     void toFile(const juce::File &file);
 
+    /**
+     * Serializes this pattern into the specified stream in a compact binary form: the timebase and the loop, followed
+     * by a packed array of notes. Each note record is prefixed by its size, so that fields can be appended to it in
+     * the future.
+     *
+     * @param out the stream to write into
+     */
+    void toStream(juce::OutputStream &out);
+
     /**
      * @return the loop length of this pattern.
      */
@@ -120,13 +194,32 @@ public:
      */
     static ArpPattern fromValueTree(juce::ValueTree &tree);
 
+    /**
+     * Deserializes a pattern written by `toStream()` from the specified stream.
+     *
+     * @param in the stream to read from
+     * @return the pattern read from the stream (empty if failed)
+     */
+    static ArpPattern fromStream(juce::InputStream &in);
+
+    /**
+     * Deserializes a pattern from an XML document in the schema of `toValueTree()`, read from the specified stream.
+     * Notes are read one by one, without building the tree in memory.
+     *
+     * @param in the stream to read from
+     * @param outSuccess if not `nullptr`, set to whether the document is a well-formed pattern
+     * @return the pattern represented by the document (empty if failed)
+     */
+    static ArpPattern fromXmlStream(juce::InputStream &in, bool *outSuccess = nullptr);
+
     /**
      * Loads the specified file and deserializes it into the pattern it represents.
      *
      * @param file the file to load
+     * @param outSuccess if not `nullptr`, set to whether the file has been read and is a well-formed pattern
      * @return the pattern represented by the file (empty if failed)
      */
-    static ArpPattern fromFile(const juce::File &file);
+    static ArpPattern fromFile(const juce::File &file, bool *outSuccess = nullptr);
 
 private:
 
@@ -140,6 +233,11 @@ private:
      */
     std::vector<ArpNote> notes;
 
+    /**
+     * The index of the notes by time, rebuilt lazily.
+     */
+    NoteIntervalIndex noteIndex;
+
     /**
      * The pattern's mutex.
      */
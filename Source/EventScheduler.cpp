@@ -0,0 +1,108 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+
+#include "EventScheduler.h"
+
+void EventScheduler::beginBlock(const ArpBuiltEvents &newEvents,
+                                int64_t newLoopResetLength,
+                                int64_t blockStartPosition,
+                                int64_t blockEndPosition) {
+    bool continuing = valid
+            && (edited || this->events == &newEvents)
+            && this->loopResetLength == newLoopResetLength
+            && blockStartPosition <= position && position <= blockEndPosition;
+
+    this->events = &newEvents;
+    this->loopResetLength = newLoopResetLength;
+    this->blockEnd = blockEndPosition;
+
+    if (continuing) {
+        // Events before `position` have already been scheduled in the previous block
+        auto localPosition = beginSegment(position);
+        if (edited) {
+            cursor = seek(localPosition);
+        } else if (localPosition == 0) {
+            cursor = 0;
+        }
+    } else {
+        cursor = seek(beginSegment(blockStartPosition));
+    }
+
+    position = blockEndPosition;
+    valid = true;
+    edited = false;
+}
+
+bool EventScheduler::next(size_t &outEventIndex, int64_t &outTime) {
+    auto &allEvents = events->events;
+
+    while (true) {
+        if (cursor < allEvents.size()) {
+            auto time = segmentBase + allEvents[cursor].time;
+            if (time < segmentEnd) {
+                outEventIndex = cursor;
+                outTime = time;
+                cursor++;
+                return true;
+            }
+        }
+
+        if (segmentEnd >= blockEnd) {
+            return false;
+        }
+
+        // Wrap around to the next loop iteration or reset period; a large block (e.g. in offline rendering) may span
+        // any number of them
+        beginSegment(segmentEnd);
+        cursor = 0;
+    }
+}
+
+void EventScheduler::reset() {
+    valid = false;
+    edited = false;
+    events = nullptr;
+}
+
+void EventScheduler::eventsEdited() {
+    edited = true;
+}
+
+int64_t EventScheduler::beginSegment(int64_t segmentStart) {
+    auto loopLength = events->loopLength;
+    auto periodStart = (loopResetLength > 0) ? segmentStart - segmentStart % loopResetLength : 0;
+    auto periodPosition = segmentStart - periodStart;
+    auto localPosition = periodPosition % loopLength;
+
+    segmentBase = segmentStart - localPosition;
+    segmentEnd = std::min(blockEnd, segmentBase + loopLength);
+    if (loopResetLength > 0) {
+        segmentEnd = std::min(segmentEnd, periodStart + loopResetLength);
+    }
+
+    return localPosition;
+}
+
+size_t EventScheduler::seek(int64_t localPosition) const {
+    auto &allEvents = events->events;
+    auto it = std::lower_bound(
+            allEvents.begin(), allEvents.end(), localPosition,
+            [](const ArpBuiltEvents::Event &event, int64_t time) { return event.time < time; });
+    return static_cast<size_t>(it - allEvents.begin());
+}
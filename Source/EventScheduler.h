@@ -0,0 +1,128 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include "ArpBuiltEvents.h"
+
+/**
+ * A playback cursor into the time-sorted events of a built pattern. Only the events that fire inside of the processed
+ * block are visited, so the cost of a block depends on the number of fired events rather than on the size of the
+ * pattern. A single block may span any number of loop iterations and loop resets, in which case every occurrence of
+ * each event is scheduled.
+ *
+ * Usage: call `beginBlock()` at the start of each block, then call `next()` until it returns `false`.
+ */
+class EventScheduler {
+public:
+
+    /**
+     * Starts scheduling of a new block. If the block continues where the previous one ended, the cursor is kept;
+     * otherwise (e.g. when the transport jumps) it is re-seeked using a binary search.
+     *
+     * @param events the events to schedule; must stay alive until the block is finished
+     * @param loopResetLength the number of pulses after which the pattern restarts, or zero if it never does
+     * @param blockStartPosition the start of the block, in pulses (inclusive)
+     * @param blockEndPosition the end of the block, in pulses (exclusive)
+     */
+    void beginBlock(const ArpBuiltEvents &events,
+                    int64_t loopResetLength,
+                    int64_t blockStartPosition,
+                    int64_t blockEndPosition);
+
+    /**
+     * Gets the next event firing in the current block, in order of time.
+     *
+     * @param outEventIndex the index of the event in `ArpBuiltEvents::events`
+     * @param outTime the time the event fires at, in pulses
+     * @return `true` if an event has been written into the output variables; `false` if the block is finished
+     */
+    bool next(size_t &outEventIndex, int64_t &outTime);
+
+    /**
+     * Invalidates the cursor, so that the next block is re-seeked. Has to be called when the events change.
+     */
+    void reset();
+
+    /**
+     * Makes the next block re-seek the cursor at the position the previous block ended at. Has to be called when the
+     * events are replaced by an edited version of themselves, so that playback continues without a gap.
+     */
+    void eventsEdited();
+
+private:
+
+    /**
+     * The events being scheduled.
+     */
+    const ArpBuiltEvents *events = nullptr;
+
+    /**
+     * The number of pulses after which the pattern restarts, or zero if it never does.
+     */
+    int64_t loopResetLength = 0;
+
+    /**
+     * The end of the current block.
+     */
+    int64_t blockEnd = 0;
+
+    /**
+     * The position at which the current loop iteration has started.
+     */
+    int64_t segmentBase = 0;
+
+    /**
+     * The end of the current segment - the end of the block, of the current loop iteration or of the current reset
+     * period, whichever comes first.
+     */
+    int64_t segmentEnd = 0;
+
+    /**
+     * The index of the next event to fire in the current loop iteration.
+     */
+    size_t cursor = 0;
+
+    /**
+     * The position up to which the events have been scheduled.
+     */
+    int64_t position = 0;
+
+    /**
+     * Whether `cursor` and `position` are valid.
+     */
+    bool valid = false;
+
+    /**
+     * Whether the events have been edited since the last block, so that `cursor` needs to be re-seeked.
+     */
+    bool edited = false;
+
+    /**
+     * Sets up the segment starting at the specified position.
+     *
+     * @return the position relative to the start of the loop iteration
+     */
+    int64_t beginSegment(int64_t segmentStart);
+
+    /**
+     * Finds the index of the first event at or after the specified position relative to the loop iteration.
+     */
+    size_t seek(int64_t localPosition) const;
+};
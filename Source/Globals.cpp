@@ -61,8 +61,11 @@ const juce::Identifier Globals::TREEID_GUI_SCALE_FACTOR = "guiScaleFactor"; // N
 const juce::Identifier Globals::TREEID_NON_PLAYING_MODE = "nonPlayingMode"; // NOLINT
 const juce::Identifier Globals::TREEID_SMOOTH_SCROLLING = "smoothScrolling"; // NOLINT
 
-Globals::Globals() :
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The audio snapshot must be lock-free");
+
+Globals::Globals(bool persistent) :
         changed(false),
+        persistent(persistent),
         askedForUpdateCheckConsent(false),
         checkForUpdatesEnabled(BuildConfig::DEFAULT_CHECK_FOR_UPDATES_ENABLED),
         foundUpdateOnLastCheck(false),
@@ -81,6 +84,12 @@ Globals::Globals() :
 
     settingsFile = globalsDir.getChildFile("settings.xml");
     patternPresetsDir = globalsDir.getChildFile("presets");
+    presetIndexFile = globalsDir.getChildFile("presetindex.dat");
+
+    if (!persistent) {
+        reset();
+        return;
+    }
 
     // TODO - add better checks (e.g. what if the globalsDir is a file and not a directory for whatever reason?)
     if (!globalsDir.isDirectory()) {
@@ -107,6 +116,7 @@ void Globals::reset() {
     guiScaleFactor = 1.0;
     nonPlayingMode = NonPlayingMode::Value::PASSTHROUGH;
     smoothScrolling = true;
+    publishAudioSnapshot();
 }
 
 bool Globals::save() {
@@ -121,6 +131,9 @@ bool Globals::save() {
 
 void Globals::forceSave() {
     std::scoped_lock lock(mutex);
+    if (!persistent) {
+        return;
+    }
 
     char const *lineEnding;
 #if JUCE_WINDOWS
@@ -137,7 +150,7 @@ void Globals::forceSave() {
 void Globals::load() {
     std::scoped_lock lock(mutex);
 
-    if (settingsFile.existsAsFile()) {
+    if (persistent && settingsFile.existsAsFile()) {
         auto xmlDoc = juce::XmlDocument::parse(settingsFile);
         parseValueTree(juce::ValueTree::fromXml(*xmlDoc));
     } else {
@@ -193,6 +206,7 @@ void Globals::parseValueTree(const juce::ValueTree &tree) {
     }
     if (tree.hasProperty(TREEID_NON_PLAYING_MODE)) {
         this->nonPlayingMode = NonPlayingMode::of(tree.getProperty(TREEID_NON_PLAYING_MODE));
+        publishAudioSnapshot();
     }
     if (tree.hasProperty(TREEID_SMOOTH_SCROLLING)) {
         this->smoothScrolling = tree.getProperty(TREEID_SMOOTH_SCROLLING);
@@ -212,6 +226,10 @@ juce::File Globals::getPatternPresetsDir() {
     return this->patternPresetsDir;
 }
 
+juce::File Globals::getPresetIndexFile() {
+    return this->presetIndexFile;
+}
+
 bool Globals::isCheckForUpdatesEnabled() const {
     std::scoped_lock lock(mutex);
     return checkForUpdatesEnabled;
@@ -287,6 +305,7 @@ void Globals::setNonPlayingMode(NonPlayingMode::Value nonPlayingMode) {
     std::scoped_lock lock(mutex);
     Globals::nonPlayingMode = nonPlayingMode;
     this->changed = true;
+    publishAudioSnapshot();
 }
 
 bool Globals::isSmoothScrolling() const {
@@ -299,3 +318,20 @@ void Globals::setSmoothScrolling(bool value) {
     this->smoothScrolling = value;
     this->changed = true;
 }
+
+Globals::AudioSnapshot Globals::getAudioSnapshot() const {
+    auto packed = audioSnapshot.load(std::memory_order_acquire);
+
+    AudioSnapshot result;
+    result.version = static_cast<uint32_t>(packed >> 32);
+    result.nonPlayingMode = static_cast<NonPlayingMode::Value>(packed & 0xFFFFFFFF);
+    return result;
+}
+
+void Globals::publishAudioSnapshot() {
+    // Only ever written with the mutex held, so the version cannot be incremented concurrently
+    auto version = static_cast<uint32_t>(audioSnapshot.load(std::memory_order_relaxed) >> 32) + 1;
+    auto packed = (static_cast<uint64_t>(version) << 32)
+            | static_cast<uint64_t>(static_cast<uint32_t>(nonPlayingMode));
+    audioSnapshot.store(packed, std::memory_order_release);
+}
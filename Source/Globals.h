@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <juce_core/juce_core.h>
 #include <juce_data_structures/juce_data_structures.h>
@@ -58,8 +60,25 @@ public:
     static const juce::Identifier TREEID_NON_PLAYING_MODE;
     static const juce::Identifier TREEID_SMOOTH_SCROLLING;
 
+    /**
+     * A consistent copy of the globals relevant to the audio thread.
+     */
+    struct AudioSnapshot {
+        /**
+         * Incremented with every change of the snapshot.
+         */
+        uint32_t version = 0;
+
+        NonPlayingMode::Value nonPlayingMode = NonPlayingMode::Value::PASSTHROUGH;
+    };
 
-    explicit Globals();
+
+    /**
+     * @param persistent whether the settings are loaded from and saved to the settings file; non-persistent globals
+     *                   (used by command-line tools) keep the default settings and do not touch the global data
+     *                   directory
+     */
+    explicit Globals(bool persistent = true);
     ~Globals();
 
 
@@ -120,6 +139,11 @@ public:
      */
     juce::File getPatternPresetsDir();
 
+    /**
+     * @return the file where the index of the pattern presets is cached
+     */
+    juce::File getPresetIndexFile();
+
     bool isCheckForUpdatesEnabled() const;
 
     void setCheckForUpdatesEnabled(bool checkForUpdates);
@@ -152,6 +176,14 @@ public:
 
     void setNonPlayingMode(NonPlayingMode::Value nonPlayingMode);
 
+    /**
+     * Gets the current snapshot of the globals relevant to the audio thread. Lock-free, so it is safe to call from the
+     * audio thread, even while the settings are being loaded or saved.
+     *
+     * @return the current audio snapshot
+     */
+    AudioSnapshot getAudioSnapshot() const;
+
 private:
 
     /**
@@ -169,11 +201,21 @@ private:
      */
     juce::File patternPresetsDir;
 
+    /**
+     * Cached index of the presets directory.
+     */
+    juce::File presetIndexFile;
+
     /**
      * This flag is <code>true</code> if the global settings have changed since the last save/load.
      */
     bool changed;
 
+    /**
+     * Whether the settings are loaded from and saved to the settings file.
+     */
+    bool persistent;
+
     /**
      * Whether the GUI of the plugin has already asked the user for consent about automatic update checks.
      */
@@ -220,6 +262,19 @@ private:
      */
     mutable std::recursive_mutex mutex;
 
+    /**
+     * The current audio snapshot, packed into a single word.
+     *
+     * @see getAudioSnapshot()
+     */
+    std::atomic<uint64_t> audioSnapshot = 0;
+
+    /**
+     * Publishes the audio-relevant globals as a new snapshot. Must be called with the mutex held, after each change of
+     * those globals.
+     */
+    void publishAudioSnapshot();
+
 };
 
 
@@ -0,0 +1,122 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "GrooveTable.h"
+#include "util/MathConsts.h"
+
+GrooveTable::GrooveTable(const GrooveTemplate &groove, int64_t timebase) {
+    if (timebase <= 0) {
+        return;
+    }
+
+    if (groove.type == GrooveTemplate::Type::STEPS && !groove.steps.empty()) {
+        buildSteps(groove, timebase);
+    } else {
+        buildSine(timebase);
+    }
+}
+
+double GrooveTable::warp(double position, float amount) const {
+    if (amount == 0.0f || displacements.empty()) {
+        // The resulting modifier would be zero, anyway, so no need to look it up.
+        return position;
+    }
+
+    auto cycles = std::floor(position / cycleLength);
+    auto x = (position - cycles * cycleLength) * samplesPerPulse;
+    auto i = std::min(static_cast<size_t>(x), displacements.size() - 2);
+    auto fraction = x - static_cast<double>(i);
+    auto displacement = displacements[i] + (displacements[i + 1] - displacements[i]) * fraction;
+    return position + amount * displacement;
+}
+
+bool GrooveTable::hasVelocities() const {
+    return !velocities.empty();
+}
+
+double GrooveTable::getVelocityMultiplier(int64_t time, float amount) const {
+    if (velocities.empty()) {
+        return 1.0;
+    }
+
+    auto position = static_cast<double>(time);
+    auto phase = position - std::floor(position / cycleLength) * cycleLength;
+    auto step = static_cast<size_t>(std::floor(phase / stepLength + 0.5)) % velocities.size();
+    return 1.0 + amount * (velocities[step] - 1.0);
+}
+
+void GrooveTable::buildSine(int64_t timebase) {
+    // One swing cycle per 8th note
+    cycleLength = static_cast<double>(timebase) / 2.0;
+    samplesPerPulse = SINE_SAMPLES / cycleLength;
+
+    auto swingFreq = (2 * X_PI) / cycleLength;
+    displacements.resize(SINE_SAMPLES + 1);
+    for (size_t i = 0; i <= SINE_SAMPLES; i++) {
+        auto position = static_cast<double>(i) / samplesPerPulse;
+        displacements[i] = -std::sin(position * swingFreq) / swingFreq;
+    }
+}
+
+void GrooveTable::buildSteps(const GrooveTemplate &groove, int64_t timebase) {
+    auto numSteps = groove.steps.size();
+    stepLength = static_cast<double>(timebase) / juce::jmax(1, groove.stepsPerBeat);
+    cycleLength = stepLength * static_cast<double>(numSteps);
+
+    auto numSamples = numSteps * SAMPLES_PER_STEP;
+    samplesPerPulse = static_cast<double>(numSamples) / cycleLength;
+
+    // The groove moves the start of step `k` from `k` to `k + timing` steps; between the steps, time flows linearly.
+    // The table needs the inverse, from host time to pattern time, so the breakpoints are placed in host time. One
+    // step on each side of the cycle is added, so that the breakpoints span the whole cycle.
+    auto numBreakpoints = numSteps + 3;
+    std::vector<double> hostBreakpoints(numBreakpoints);
+    std::vector<double> patternBreakpoints(numBreakpoints);
+    for (size_t b = 0; b < numBreakpoints; b++) {
+        auto step = static_cast<int64_t>(b) - 1;
+        auto index = static_cast<size_t>((step + static_cast<int64_t>(numSteps)) % static_cast<int64_t>(numSteps));
+        patternBreakpoints[b] = static_cast<double>(step) * stepLength;
+        hostBreakpoints[b] = (static_cast<double>(step) + groove.steps[index].timing) * stepLength;
+    }
+
+    displacements.resize(numSamples + 1);
+    size_t b = 0;
+    for (size_t i = 0; i <= numSamples; i++) {
+        auto position = static_cast<double>(i) / samplesPerPulse;
+        while (b + 2 < numBreakpoints && hostBreakpoints[b + 1] <= position) {
+            b++;
+        }
+
+        // Zero-length segments are skipped by the search above, so the divisor is positive
+        auto fraction = (position - hostBreakpoints[b]) / (hostBreakpoints[b + 1] - hostBreakpoints[b]);
+        auto patternPosition = patternBreakpoints[b] + (patternBreakpoints[b + 1] - patternBreakpoints[b]) * fraction;
+        displacements[i] = patternPosition - position;
+    }
+
+    auto changesVelocities = std::any_of(groove.steps.begin(), groove.steps.end(), [](auto &step) {
+        return step.velocity != 1.0;
+    });
+    if (changesVelocities) {
+        velocities.resize(numSteps);
+        for (size_t s = 0; s < numSteps; s++) {
+            velocities[s] = groove.steps[s].velocity;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GrooveTemplate.h"
+
+/**
+ * A groove template precomputed for a specific timebase, so that applying it costs only a table lookup.
+ *
+ * The table maps positions in host time to positions in pattern time, both in pulses. It stores the displacement of
+ * the groove at full swing over one cycle, sampled at regular intervals; the displacement at lower swing amounts is
+ * scaled down linearly.
+ */
+class GrooveTable {
+public:
+
+    /**
+     * The number of samples per cycle of sinusoidal swing.
+     */
+    static constexpr size_t SINE_SAMPLES = 256;
+
+    /**
+     * The number of samples per step of step grooves.
+     */
+    static constexpr size_t SAMPLES_PER_STEP = 32;
+
+    /**
+     * Constructs a table applying no groove.
+     */
+    GrooveTable() = default;
+
+    /**
+     * Precomputes the specified groove for the specified timebase.
+     *
+     * @param groove the groove
+     * @param timebase the timebase in PPQ
+     */
+    GrooveTable(const GrooveTemplate &groove, int64_t timebase);
+
+    /**
+     * Calculates the pattern position played at the specified position, with the groove applied.
+     *
+     * @param position the position in pulses
+     * @param amount the swing amount, from `0.0` to `1.0`
+     * @return the position with the groove applied
+     */
+    double warp(double position, float amount) const;
+
+    /**
+     * @return whether the groove changes the velocities of notes
+     */
+    bool hasVelocities() const;
+
+    /**
+     * Gets the velocity multiplier of notes at the specified pattern position.
+     *
+     * @param time the pattern position in pulses
+     * @param amount the swing amount, from `0.0` to `1.0`
+     * @return the velocity multiplier
+     */
+    double getVelocityMultiplier(int64_t time, float amount) const;
+
+private:
+
+    /**
+     * The length of a cycle of the groove, in pulses.
+     */
+    double cycleLength = 0.0;
+
+    /**
+     * The number of samples per pulse.
+     */
+    double samplesPerPulse = 0.0;
+
+    /**
+     * The displacements at full swing, sampled over one cycle. Has an extra sample at the end of the cycle, equal to
+     * the first one, so that interpolation does not need to wrap around.
+     */
+    std::vector<double> displacements;
+
+    /**
+     * The length of a step, in pulses.
+     */
+    double stepLength = 0.0;
+
+    /**
+     * The velocity multipliers of the steps at full swing. Empty if the groove does not change velocities.
+     */
+    std::vector<double> velocities;
+
+    void buildSine(int64_t timebase);
+    void buildSteps(const GrooveTemplate &groove, int64_t timebase);
+};
@@ -0,0 +1,194 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "GrooveTemplate.h"
+
+const juce::Identifier GrooveTemplate::TREEID_GROOVE = "groove"; // NOLINT
+const juce::Identifier GrooveTemplate::TREEID_NAME = "name"; // NOLINT
+const juce::Identifier GrooveTemplate::TREEID_TYPE = "type"; // NOLINT
+const juce::Identifier GrooveTemplate::TREEID_STEPS_PER_BEAT = "stepsPerBeat"; // NOLINT
+const juce::Identifier GrooveTemplate::TREEID_STEP = "step"; // NOLINT
+const juce::Identifier GrooveTemplate::TREEID_TIMING = "timing"; // NOLINT
+const juce::Identifier GrooveTemplate::TREEID_VELOCITY = "velocity"; // NOLINT
+
+static const char *TYPE_SINE = "sine";
+static const char *TYPE_STEPS = "steps";
+
+
+bool GrooveTemplate::Step::operator==(const Step &other) const {
+    return timing == other.timing && velocity == other.velocity;
+}
+
+bool GrooveTemplate::Step::operator!=(const Step &other) const {
+    return !(*this == other);
+}
+
+bool GrooveTemplate::operator==(const GrooveTemplate &other) const {
+    return type == other.type
+            && name == other.name
+            && stepsPerBeat == other.stepsPerBeat
+            && steps == other.steps;
+}
+
+bool GrooveTemplate::operator!=(const GrooveTemplate &other) const {
+    return !(*this == other);
+}
+
+
+juce::ValueTree GrooveTemplate::toValueTree() const {
+    juce::ValueTree result = juce::ValueTree(TREEID_GROOVE);
+    result.setProperty(TREEID_NAME, this->name, nullptr);
+    result.setProperty(TREEID_TYPE, (this->type == Type::STEPS) ? TYPE_STEPS : TYPE_SINE, nullptr);
+    result.setProperty(TREEID_STEPS_PER_BEAT, this->stepsPerBeat, nullptr);
+    for (auto &step : this->steps) {
+        juce::ValueTree stepTree = juce::ValueTree(TREEID_STEP);
+        stepTree.setProperty(TREEID_TIMING, step.timing, nullptr);
+        stepTree.setProperty(TREEID_VELOCITY, step.velocity, nullptr);
+        result.appendChild(stepTree, nullptr);
+    }
+    return result;
+}
+
+GrooveTemplate GrooveTemplate::fromValueTree(juce::ValueTree &tree) {
+    if (!tree.isValid() || !tree.hasType(TREEID_GROOVE)) {
+        throw std::invalid_argument("Input tree must be valid and of the correct type!");
+    }
+
+    GrooveTemplate result = GrooveTemplate();
+    if (tree.hasProperty(TREEID_NAME)) {
+        result.name = tree.getProperty(TREEID_NAME);
+    }
+    if (tree.hasProperty(TREEID_TYPE) && tree.getProperty(TREEID_TYPE).toString() == TYPE_STEPS) {
+        result.type = Type::STEPS;
+    }
+    if (tree.hasProperty(TREEID_STEPS_PER_BEAT)) {
+        result.stepsPerBeat = juce::jmax(1, static_cast<int>(tree.getProperty(TREEID_STEPS_PER_BEAT)));
+    }
+
+    for (auto stepTree : tree) {
+        if (!stepTree.hasType(TREEID_STEP)) {
+            continue;
+        }
+
+        Step step;
+        if (stepTree.hasProperty(TREEID_TIMING)) {
+            auto timing = static_cast<double>(stepTree.getProperty(TREEID_TIMING));
+            step.timing = juce::jlimit(-MAX_TIMING, MAX_TIMING, timing);
+        }
+        if (stepTree.hasProperty(TREEID_VELOCITY)) {
+            auto velocity = static_cast<double>(stepTree.getProperty(TREEID_VELOCITY));
+            step.velocity = juce::jlimit(0.0, MAX_VELOCITY, velocity);
+        }
+        result.steps.push_back(step);
+    }
+
+    if (result.type == Type::STEPS && result.steps.empty()) {
+        // A step groove without steps would have nothing to play with
+        return sine();
+    }
+
+    return result;
+}
+
+
+GrooveTemplate GrooveTemplate::sine() {
+    return GrooveTemplate();
+}
+
+GrooveTemplate GrooveTemplate::mpcSwing(double percentage) {
+    percentage = juce::jlimit(0.5, 0.75, percentage);
+
+    GrooveTemplate result;
+    result.type = Type::STEPS;
+    result.name = "MPC 16th " + juce::String(juce::roundToInt(percentage * 100.0)) + "%";
+    result.stepsPerBeat = 4;
+
+    // The delayed 16th sits at `percentage` of its 8th, which is two steps long
+    Step straight;
+    Step delayed;
+    delayed.timing = (percentage - 0.5) * 2.0;
+    result.steps = { straight, delayed };
+    return result;
+}
+
+GrooveTemplate GrooveTemplate::fromMidiFile(const juce::File &file, int stepsPerBeat, int numSteps) {
+    stepsPerBeat = juce::jmax(1, stepsPerBeat);
+    numSteps = juce::jmax(1, numSteps);
+
+    juce::FileInputStream stream(file);
+    juce::MidiFile midiFile;
+    if (!stream.openedOk() || !midiFile.readFrom(stream)) {
+        throw std::invalid_argument("The file could not be read as a MIDI file!");
+    }
+
+    auto ticksPerQuarter = midiFile.getTimeFormat();
+    if (ticksPerQuarter <= 0) {
+        throw std::invalid_argument("MIDI files with SMPTE timing are not supported!");
+    }
+
+    std::vector<double> timingSums(static_cast<size_t>(numSteps), 0.0);
+    std::vector<double> velocitySums(static_cast<size_t>(numSteps), 0.0);
+    std::vector<int> counts(static_cast<size_t>(numSteps), 0);
+    double totalVelocity = 0.0;
+    int totalCount = 0;
+
+    for (int t = 0; t < midiFile.getNumTracks(); t++) {
+        auto track = midiFile.getTrack(t);
+        for (auto event : *track) {
+            auto &message = event->message;
+            if (!message.isNoteOn()) {
+                continue;
+            }
+
+            auto position = message.getTimeStamp() / ticksPerQuarter * stepsPerBeat;
+            auto nearestStep = static_cast<int64_t>(std::floor(position + 0.5));
+            auto index = static_cast<size_t>(((nearestStep % numSteps) + numSteps) % numSteps);
+
+            timingSums[index] += position - static_cast<double>(nearestStep);
+            velocitySums[index] += message.getFloatVelocity();
+            counts[index]++;
+            totalVelocity += message.getFloatVelocity();
+            totalCount++;
+        }
+    }
+
+    if (totalCount == 0 || totalVelocity <= 0.0) {
+        throw std::invalid_argument("The MIDI file contains no notes!");
+    }
+
+    auto meanVelocity = totalVelocity / totalCount;
+
+    GrooveTemplate result;
+    result.type = Type::STEPS;
+    result.name = file.getFileNameWithoutExtension();
+    result.stepsPerBeat = stepsPerBeat;
+    result.steps.resize(static_cast<size_t>(numSteps));
+    for (size_t i = 0; i < result.steps.size(); i++) {
+        if (counts[i] == 0) {
+            // Nothing played on this step, so keep it straight
+            continue;
+        }
+
+        auto &step = result.steps[i];
+        step.timing = juce::jlimit(-MAX_TIMING, MAX_TIMING, timingSums[i] / counts[i]);
+        step.velocity = juce::jlimit(0.0, MAX_VELOCITY, velocitySums[i] / counts[i] / meanVelocity);
+    }
+
+    return result;
+}
@@ -0,0 +1,149 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <vector>
+#include <juce_core/juce_core.h>
+#include <juce_data_structures/juce_data_structures.h>
+
+/**
+ * A groove template, describing the feel swing applies to a pattern.
+ *
+ * A template is either the classic sinusoidal swing, or a cycle of steps, each with a timing offset and a velocity
+ * multiplier. The template describes the feel at full swing; lower swing amounts blend it towards straight timing.
+ */
+class GrooveTemplate {
+public:
+
+    static const juce::Identifier TREEID_GROOVE;
+    static const juce::Identifier TREEID_NAME;
+    static const juce::Identifier TREEID_TYPE;
+    static const juce::Identifier TREEID_STEPS_PER_BEAT;
+    static const juce::Identifier TREEID_STEP;
+    static const juce::Identifier TREEID_TIMING;
+    static const juce::Identifier TREEID_VELOCITY;
+
+    /**
+     * The maximum absolute timing offset of a step, in steps.
+     */
+    static constexpr double MAX_TIMING = 0.5;
+
+    /**
+     * The maximum velocity multiplier of a step.
+     */
+    static constexpr double MAX_VELOCITY = 2.0;
+
+    static constexpr int DEFAULT_STEPS_PER_BEAT = 4;
+    static constexpr int DEFAULT_NUM_STEPS = 16;
+
+    enum class Type {
+        /**
+         * The classic sinusoidal swing.
+         */
+        SINE,
+
+        /**
+         * A cycle of steps with timing and velocity offsets.
+         */
+        STEPS
+    };
+
+    /**
+     * A single step of a groove.
+     */
+    struct Step {
+        /**
+         * The timing offset of the step, as a fraction of the step length. Positive values delay the step.
+         */
+        double timing = 0.0;
+
+        /**
+         * The velocity multiplier of notes on the step.
+         */
+        double velocity = 1.0;
+
+        bool operator==(const Step &other) const;
+        bool operator!=(const Step &other) const;
+    };
+
+
+    Type type = Type::SINE;
+
+    /**
+     * The name of the groove, for display.
+     */
+    juce::String name = "Sine";
+
+    /**
+     * The number of steps per beat.
+     */
+    int stepsPerBeat = DEFAULT_STEPS_PER_BEAT;
+
+    /**
+     * The steps of one cycle of the groove. Unused by sinusoidal swing.
+     */
+    std::vector<Step> steps;
+
+
+    bool operator==(const GrooveTemplate &other) const;
+    bool operator!=(const GrooveTemplate &other) const;
+
+    /**
+     * Serializes this groove into a ValueTree.
+     *
+     * @return a ValueTree representing this groove
+     */
+    [[nodiscard]] juce::ValueTree toValueTree() const;
+
+    /**
+     * Deserializes the specified ValueTree into a groove.
+     *
+     * @param tree the tree to deserialize
+     * @return the groove represented by the ValueTree
+     */
+    static GrooveTemplate fromValueTree(juce::ValueTree &tree);
+
+    /**
+     * @return the classic sinusoidal swing
+     */
+    static GrooveTemplate sine();
+
+    /**
+     * Creates an MPC-style 16th swing, which delays every other 16th note.
+     *
+     * @param percentage the swing percentage, i.e. the position of the delayed 16th within its 8th; from `0.5`
+     * (straight) to `0.75`
+     * @return the groove
+     */
+    static GrooveTemplate mpcSwing(double percentage);
+
+    /**
+     * Extracts a groove from the notes of a MIDI file. Each note is snapped to the nearest step, and the timing
+     * offsets and velocities of the notes on each step of the cycle are averaged.
+     *
+     * @param file the MIDI file
+     * @param stepsPerBeat the number of steps per beat
+     * @param numSteps the number of steps in a cycle
+     * @return the extracted groove
+     * @throws std::invalid_argument if the file cannot be read or contains no notes
+     */
+    static GrooveTemplate fromMidiFile(
+            const juce::File &file,
+            int stepsPerBeat = DEFAULT_STEPS_PER_BEAT,
+            int numSteps = DEFAULT_NUM_STEPS);
+};
@@ -0,0 +1,107 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "InputChord.h"
+#include "util/BitUtils.h"
+
+void InputChord::add(int note, double velocity) {
+    if (note < 0 || note >= NUM_NOTES) {
+        return;
+    }
+
+    auto &word = held[static_cast<size_t>(note / 64)];
+    auto bit = uint64_t(1) << (note % 64);
+    if ((word & bit) == 0) {
+        word |= bit;
+        count++;
+        dirty = true;
+    }
+    velocities[static_cast<size_t>(note)] = velocity;
+}
+
+void InputChord::remove(int note) {
+    if (note < 0 || note >= NUM_NOTES) {
+        return;
+    }
+
+    auto &word = held[static_cast<size_t>(note / 64)];
+    auto bit = uint64_t(1) << (note % 64);
+    if ((word & bit) != 0) {
+        word &= ~bit;
+        count--;
+        dirty = true;
+    }
+}
+
+void InputChord::clear() {
+    held.fill(0);
+    count = 0;
+    dirty = false;
+}
+
+int InputChord::size() const {
+    return count;
+}
+
+bool InputChord::isEmpty() const {
+    return count == 0;
+}
+
+int InputChord::getNote(int index) const {
+    if (index < 0 || index >= count) {
+        return -1;
+    }
+
+    if (dirty) {
+        rebuildOrdered();
+    }
+    return ordered[static_cast<size_t>(index)];
+}
+
+double InputChord::getVelocity(int note) const {
+    return velocities[static_cast<size_t>(note)];
+}
+
+int InputChord::getLowest() const {
+    for (int i = 0; i < NUM_WORDS; i++) {
+        if (held[static_cast<size_t>(i)] != 0) {
+            return i * 64 + BitUtils::countTrailingZeros(held[static_cast<size_t>(i)]);
+        }
+    }
+    return -1;
+}
+
+int InputChord::getHighest() const {
+    for (int i = NUM_WORDS - 1; i >= 0; i--) {
+        if (held[static_cast<size_t>(i)] != 0) {
+            return i * 64 + BitUtils::highestSetBit(held[static_cast<size_t>(i)]);
+        }
+    }
+    return -1;
+}
+
+void InputChord::rebuildOrdered() const {
+    size_t index = 0;
+    for (int i = 0; i < NUM_WORDS; i++) {
+        auto word = held[static_cast<size_t>(i)];
+        while (word != 0) {
+            ordered[index++] = static_cast<uint8_t>(i * 64 + BitUtils::countTrailingZeros(word));
+            word &= word - 1;
+        }
+    }
+    dirty = false;
+}
@@ -0,0 +1,121 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The set of currently held input notes, along with their velocities.
+ *
+ * The held notes are kept in a 128-bit bitmap. Notes are selected by index through an ordered array, which is only
+ * rebuilt on the first lookup after the chord changes. Nothing is ever allocated.
+ */
+class InputChord {
+public:
+
+    /**
+     * The number of possible MIDI notes.
+     */
+    static constexpr int NUM_NOTES = 128;
+
+    /**
+     * Adds a held note, or updates its velocity if it is already held. Notes out of the MIDI range are ignored.
+     *
+     * @param note the MIDI note number
+     * @param velocity the velocity of the note, from 0 to 1
+     */
+    void add(int note, double velocity);
+
+    /**
+     * Removes a held note, if it is held.
+     *
+     * @param note the MIDI note number
+     */
+    void remove(int note);
+
+    /**
+     * Removes all held notes.
+     */
+    void clear();
+
+    /**
+     * @return the number of held notes
+     */
+    int size() const;
+
+    /**
+     * @return whether no notes are held
+     */
+    bool isEmpty() const;
+
+    /**
+     * Gets the held note at the specified index, the notes being ordered from the lowest one.
+     *
+     * @param index the index of the note
+     * @return the MIDI note number, or -1 if the index is out of range
+     */
+    int getNote(int index) const;
+
+    /**
+     * @return the velocity of the specified note, from 0 to 1; undefined if the note is not held
+     */
+    double getVelocity(int note) const;
+
+    /**
+     * @return the lowest held note, or -1 if no notes are held
+     */
+    int getLowest() const;
+
+    /**
+     * @return the highest held note, or -1 if no notes are held
+     */
+    int getHighest() const;
+
+private:
+
+    static constexpr int NUM_WORDS = NUM_NOTES / 64;
+
+    /**
+     * The bitmap of held notes.
+     */
+    std::array<uint64_t, NUM_WORDS> held {};
+
+    /**
+     * The velocities of the notes, indexed by note number.
+     */
+    std::array<double, NUM_NOTES> velocities {};
+
+    /**
+     * The held notes, ordered from the lowest one. Only valid if not `dirty`.
+     */
+    mutable std::array<uint8_t, NUM_NOTES> ordered {};
+
+    /**
+     * Whether `ordered` needs to be rebuilt.
+     */
+    mutable bool dirty = false;
+
+    /**
+     * The number of held notes.
+     */
+    int count = 0;
+
+    void rebuildOrdered() const;
+};
@@ -15,13 +15,17 @@
 // along with this program.  If not, see https://librearp.gitlab.io/license/.
 //
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include "LibreArp.h"
+#include "ArpBuiltEventsCache.h"
 #include "editor/MainEditor.h"
-#include "util/MathConsts.h"
+#include "util/AllocationDetector.h"
+#include "util/BitUtils.h"
 
 const juce::Identifier LibreArp::TREEID_LIBREARP                   = "libreArpPlugin"; // NOLINT
 const juce::Identifier LibreArp::TREEID_LOOP_RESET                 = "loopReset"; // NOLINT
-const juce::Identifier LibreArp::TREEID_PATTERN_XML                = "patternXml"; // NOLINT
 const juce::Identifier LibreArp::TREEID_OCTAVES                    = "octaves"; // NOLINT
 const juce::Identifier LibreArp::TREEID_SMART_OCTAVES              = "smartOctaves"; // NOLINT
 const juce::Identifier LibreArp::TREEID_INPUT_VELOCITY             = "usingInputVelocity"; // NOLINT
@@ -34,42 +38,164 @@ const juce::Identifier LibreArp::TREEID_INPUT_MIDI_CHANNEL         = "inputMidiC
 const juce::Identifier LibreArp::TREEID_NON_PLAYING_MODE_OVERRIDE  = "nonPlayingModeOverride"; // NOLINT
 const juce::Identifier LibreArp::TREEID_BYPASS                     = "bypass"; // NOLINT
 const juce::Identifier LibreArp::TREEID_PATTERN_OFFSET             = "patternOffset"; // NOLINT
+const juce::Identifier LibreArp::TREEID_PATTERN_OFFSET_QUARTERS    = "patternOffsetQuarters"; // NOLINT
 const juce::Identifier LibreArp::TREEID_USER_TIME_SIG              = "userTimeSig"; // NOLINT
 const juce::Identifier LibreArp::TREEID_USER_TIME_SIG_NUMERATOR    = "userTimeSigNumerator"; // NOLINT
 const juce::Identifier LibreArp::TREEID_USER_TIME_SIG_DENOMINATOR  = "userTimeSigDenominator"; // NOLINT
+const juce::Identifier LibreArp::TREEID_LAYERS                     = "layers"; // NOLINT
+const juce::Identifier LibreArp::TREEID_LAYER                      = "layer"; // NOLINT
+const juce::Identifier LibreArp::TREEID_EDITED_LAYER               = "editedLayer"; // NOLINT
 
 static const int NOTES_IN_OCTAVE = 12;
 
+/**
+ * The minimum number of MIDI events the output buffer is reserved for - enough for a note-on and a note-off of every
+ * note on every channel, twice over.
+ */
+static const size_t RESERVED_MIDI_EVENTS = 16 * 128 * 4;
+
+/**
+ * The number of MIDI events the output buffer is reserved for per sample of the host's block size, so that large
+ * blocks (e.g. in offline rendering), which span more pattern events, get a proportionally larger buffer.
+ */
+static const size_t RESERVED_MIDI_EVENTS_PER_SAMPLE = 16;
+
+/**
+ * The maximum number of MIDI events the output buffer is reserved for, regardless of the block size.
+ */
+static const size_t MAX_RESERVED_MIDI_EVENTS = size_t(1) << 22;
+
+/**
+ * The number of bytes reserved for output MIDI events longer than a short message, i.e. passed-through SysEx.
+ */
+static const size_t RESERVED_LONG_MIDI_BYTES = 64 * 1024;
+
+/**
+ * The magic bytes the binary state starts with. States saved by older versions are XML strings, which cannot start
+ * with them.
+ */
+static const char STATE_MAGIC[4] = { 'L', 'A', 'R', 'P' };
+
+/**
+ * The version of the binary state format, bumped on incompatible changes only; new data goes into new sections.
+ */
+static const int STATE_VERSION = 1;
+
+/**
+ * The sections of the binary state. Each section is stored as its type, its size in bytes and its contents; sections
+ * of unknown types are skipped.
+ */
+enum StateSection {
+
+    /**
+     * The properties of the processor, as a binary ValueTree without the patterns.
+     */
+    STATE_SECTION_PROPERTIES = 1,
+
+    /**
+     * The pattern of a layer, written by `ArpPattern::toStream()`. There is one for each layer, in order.
+     */
+    STATE_SECTION_PATTERN = 2
+};
+
+/**
+ * The size of the type and size fields of a state section.
+ */
+static const int STATE_SECTION_HEADER_SIZE = 8;
+
+/**
+ * Writes a state section with the contents written by the specified function, filling in its size afterwards.
+ */
+template<typename F>
+static void writeStateSection(juce::MemoryOutputStream &out, StateSection type, F &&writeContents) {
+    out.writeInt(type);
+    auto sizePosition = out.getPosition();
+    out.writeInt(0);
+    writeContents(out);
+
+    auto endPosition = out.getPosition();
+    out.setPosition(sizePosition);
+    out.writeInt(static_cast<int>(endPosition - sizePosition - 4));
+    out.setPosition(endPosition);
+}
+
 
 LibreArp::InputNote::InputNote(int note, double velocity) : note(note), velocity(velocity) {}
 
-bool operator>(const LibreArp::InputNote &a, const LibreArp::InputNote &b) {
-    return a.note > b.note;
+LibreArp::PlayingEvents::PlayingEvents(std::shared_ptr<const ArpBuiltEvents> table,
+                                       std::shared_ptr<const GrooveTable> groove)
+        : table(std::move(table)),
+          groove(std::move(groove)),
+          outputNotes(this->table->data.noteNumbers),
+          lastNotes(this->table->data.size(), ArpBuiltEvents::PlayingNote(-1, -1)),
+          playingIndices((lastNotes.size() + 63) / 64, 0) {}
+
+void LibreArp::PlayingEvents::setLastNote(uint32_t index, ArpBuiltEvents::PlayingNote note) {
+    lastNotes[index] = note;
+    playingIndices[index / 64] |= uint64_t(1) << (index % 64);
 }
 
-bool operator<(const LibreArp::InputNote &a, const LibreArp::InputNote &b) {
-    return a.note < b.note;
+void LibreArp::PlayingEvents::clearLastNote(uint32_t index) {
+    lastNotes[index] = ArpBuiltEvents::PlayingNote(-1, -1);
+    playingIndices[index / 64] &= ~(uint64_t(1) << (index % 64));
 }
 
-bool operator>=(const LibreArp::InputNote &a, const LibreArp::InputNote &b) {
-    return a.note >= b.note;
+void LibreArp::PlayingEvents::clearLastNotes() {
+    for (size_t w = 0; w < playingIndices.size(); w++) {
+        auto word = playingIndices[w];
+        while (word != 0) {
+            lastNotes[w * 64 + static_cast<size_t>(BitUtils::countTrailingZeros(word))] =
+                    ArpBuiltEvents::PlayingNote(-1, -1);
+            word &= word - 1;
+        }
+        playingIndices[w] = 0;
+    }
 }
 
-bool operator<=(const LibreArp::InputNote &a, const LibreArp::InputNote &b) {
-    return a.note <= b.note;
+void LibreArp::PlayingEvents::markEdited(const std::vector<size_t> &changed) {
+    edited = true;
+    changedIndices.assign(playingIndices.size(), 0);
+    for (auto index : changed) {
+        if (index < lastNotes.size()) {
+            changedIndices[index / 64] |= uint64_t(1) << (index % 64);
+        }
+    }
 }
 
-bool operator==(const LibreArp::InputNote &a, const LibreArp::InputNote &b) {
-    return a.note == b.note;
+void LibreArp::PlayingEvents::mergeEdits(const PlayingEvents &replaced) {
+    if (!replaced.edited) {
+        // The replaced events were not an edit, so neither are these, relative to the ones being played
+        edited = false;
+        changedIndices.clear();
+        return;
+    }
+
+    auto numWords = std::min(changedIndices.size(), replaced.changedIndices.size());
+    for (size_t w = 0; w < numWords; w++) {
+        changedIndices[w] |= replaced.changedIndices[w];
+    }
+}
+
+bool LibreArp::PlayingEvents::isChanged(uint32_t index) const {
+    return (changedIndices[index / 64] >> (index % 64)) & 1;
+}
+
+LibreArp::Layer::Layer() : events(std::make_unique<PlayingEvents>(std::make_shared<ArpBuiltEvents>())) {}
+
+LibreArp::Layer::~Layer() {
+    delete pendingEvents.exchange(nullptr);
+    delete retiredEvents.exchange(nullptr);
 }
 
 // NOTE: The plugin technically should not need any audio channels, but there are two things:
 //        - ever since migration to JUCE 6, without any channels, it reported numSamples of 0
 //        - Renoise does not accept our MIDI output when there is no output channel
-LibreArp::LibreArp()
+LibreArp::LibreArp(bool persistentGlobals)
         : AudioProcessor(BusesProperties()
                                  .withInput("Input", juce::AudioChannelSet::mono(), true)
                                  .withOutput("Output", juce::AudioChannelSet::mono(), true)),
+          globals(persistentGlobals),
+          outputMidi(RESERVED_MIDI_EVENTS, RESERVED_LONG_MIDI_BYTES),
           silenceEndedTime(juce::Time::currentTimeMillis())
 {
     // NOTE: The parameters have to be pointers and allocated randomly on the heap because JUCE is trying to be smart
@@ -125,10 +251,21 @@ LibreArp::LibreArp()
             false,
             "Whether the offset should be changed the next time playback starts."));
 
+    for (auto *parameter : getParameters()) {
+        parameter->addListener(this);
+    }
+
+    for (auto &layer : layers) {
+        layer = std::make_unique<Layer>();
+    }
+
     globals.markChanged();
 }
 
-LibreArp::~LibreArp() = default;
+LibreArp::~LibreArp() {
+    delete pendingState.exchange(nullptr);
+    delete retiredState.exchange(nullptr);
+}
 
 //==============================================================================
 const juce::String LibreArp::getName() const {
@@ -174,11 +311,17 @@ void LibreArp::changeProgramName(int index, const juce::String &newName) {
 
 //==============================================================================
 void LibreArp::prepareToPlay(double sampleRate, int samplesPerBlock) {
-    juce::ignoreUnused(samplesPerBlock, sampleRate);
+    juce::ignoreUnused(sampleRate);
+
+    // The host does not process blocks while preparing, so the output buffer can be reallocated
+    auto reservedEvents = static_cast<size_t>(juce::jmax(samplesPerBlock, 0)) * RESERVED_MIDI_EVENTS_PER_SAMPLE;
+    outputMidi.reserve(juce::jlimit(RESERVED_MIDI_EVENTS, MAX_RESERVED_MIDI_EVENTS, reservedEvents),
+                       RESERVED_LONG_MIDI_BYTES);
+    this->prepared = true;
 }
 
 void LibreArp::releaseResources() {
-
+    this->prepared = false;
 }
 
 bool LibreArp::isBusesLayoutSupported(const BusesLayout &layouts) const {
@@ -188,6 +331,7 @@ bool LibreArp::isBusesLayoutSupported(const BusesLayout &layouts) const {
 
 void LibreArp::processBlock(juce::AudioBuffer<float> &audio, juce::MidiBuffer &midi) {
     juce::ScopedNoDenormals noDenormals;
+    AllocationDetector::Scope detectAllocations;
 
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -203,6 +347,7 @@ void LibreArp::processBlock(juce::AudioBuffer<float> &audio, juce::MidiBuffer &m
 
 void LibreArp::processBlock(juce::AudioBuffer<double> &audio, juce::MidiBuffer &midi) {
     juce::ScopedNoDenormals noDenormals;
+    AllocationDetector::Scope detectAllocations;
 
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -217,13 +362,8 @@ void LibreArp::processBlock(juce::AudioBuffer<double> &audio, juce::MidiBuffer &
 }
 
 void LibreArp::processMidi(int numSamples, juce::MidiBuffer& midi) {
-    // Build events if scheduled
-    if (buildScheduled) {
-        this->stopAll();
-        events = pattern.buildEvents();
-        updateEditor();
-        buildScheduled = false;
-    }
+    auto startTicks = juce::Time::getHighResolutionTicks();
+    uint32_t numScannedEvents = 0;
 
     // Input data processing
     juce::AudioPlayHead::CurrentPositionInfo cpi; // NOLINT
@@ -231,152 +371,244 @@ void LibreArp::processMidi(int numSamples, juce::MidiBuffer& midi) {
         getPlayHead()->getCurrentPosition(cpi);
     }
 
-    processInputMidi(midi, cpi.isPlaying);
+    auto nonPlayingMode = getNonPlayingMode();
 
-    if (lastNumInputNotes == 0 && inputNotes.size() > 0) {
-        silenceEndedTime = juce::Time::currentTimeMillis();
+    outputMidi.clear();
+
+    // Pick up a restored state, then freshly built events, which can only be newer
+    auto numLayers = this->numLayers.load();
+    applyRestoredState(outputMidi);
+    for (int i = 0; i < numLayers; i++) {
+        swapPendingEvents(*layers[i], outputMidi);
+    }
+
+    // While the host is playing, input is merged with the pattern events in sample order, so that each event plays
+    // the chord held at its own offset. Otherwise, the position is not tied to the host, so all of it is taken in at
+    // once, before the non-playing position is determined.
+    auto isHostPlaying = cpi.isPlaying;
+    auto input = midi.cbegin();
+    auto inputEnd = midi.cend();
+    if (!isHostPlaying) {
+        processInputMidi(input, inputEnd, std::numeric_limits<int>::max(), isHostPlaying, nonPlayingMode);
     }
 
-    if (!cpi.isPlaying && getNonPlayingMode() == NonPlayingMode::Value::PATTERN) {
+    if (!cpi.isPlaying && nonPlayingMode == NonPlayingMode::Value::PATTERN) {
         fillCurrentNonPlayingPositionInfo(cpi);
     }
 
     this->hostTimeSigNumerator = cpi.timeSigNumerator;
     this->hostTimeSigDenominator = cpi.timeSigDenominator;
 
-    // Output generation
-    if (!*bypass && cpi.isPlaying && !this->events.events.empty() && this->events.loopLength > 0) {
-        auto timebase = this->events.timebase;
-        auto pulseLength = 60.0 / (cpi.bpm * timebase);
-        auto pulseSamples = getSampleRate() * pulseLength;
+    bool hasEvents = false;
+    for (int i = 0; i < numLayers; i++) {
+        auto &table = *layers[i]->events->table;
+        hasEvents = hasEvents || (!table.events.empty() && table.loopLength > 0);
+    }
 
-        // Current position in pattern-space
-        auto baseBlockStartPosition = cpi.ppqPosition * timebase;
+    // Output generation
+    if (!*bypass && cpi.isPlaying && hasEvents) {
         if (*this->recordingPatternOffset) {
-            this->patternOffset = baseBlockStartPosition;
+            this->patternOffset = cpi.ppqPosition;
             *this->recordingPatternOffset = false;
+            this->stateChanged();
             this->updateHostDisplay();
             this->stopAll();
         }
 
-        baseBlockStartPosition -= this->patternOffset;
-        auto offsadd = (this->loopReset > 0)
-            ? static_cast<int64_t>(this->loopReset * timebase)
-            : this->events.loopLength;
-        if (baseBlockStartPosition < 0)
-            baseBlockStartPosition = std::fmod(baseBlockStartPosition, offsadd) + offsadd;
-
-        auto baseBlockEndPosition = baseBlockStartPosition + numSamples / pulseSamples;
-        auto blockStartPosition = static_cast<int64_t>(std::floor(applySwing(baseBlockStartPosition, lastSwing)));
-        auto blockEndPosition = static_cast<int64_t>(std::ceil(applySwing(baseBlockEndPosition, *swing)));
-
         if (stopScheduled) {
-            this->stopAll(midi);
+            this->stopAll(outputMidi);
             stopScheduled = false;
         }
 
-        if (maxChordSize->get() != 0)
-            octaveSize = maxChordSize->get();
-        else if (inputNotes.size() != 0)
-            octaveSize = inputNotes.size();
-
-        for(auto event : events.events) {
-            auto time = nextTime(event, blockStartPosition, blockEndPosition);
-
-            if (time < blockEndPosition) {
-                auto offsetBase = static_cast<int>(std::floor((double) (time - this->lastPosition) * pulseSamples));
-                int offset = juce::jmin(offsetBase, numSamples - 1);
+        for (int i = 0; i < numLayers; i++) {
+            beginLayerBlock(*layers[i], getLayerParameters(i), cpi, numSamples);
+        }
 
-                if (this->lastPosition > blockEndPosition && offset < 0) {
-                    offset = 0;
+        // Merge the events of all layers by their offsets, so that they are generated in order. There are only a few
+        // layers, so finding the earliest one linearly is cheaper than keeping a heap.
+        while (true) {
+            Layer *next = nullptr;
+            for (int i = 0; i < numLayers; i++) {
+                auto &layer = *layers[i];
+                if (layer.hasNextEvent && (next == nullptr || layer.nextEventOffset < next->nextEventOffset)) {
+                    next = &layer;
                 }
+            }
+            if (next == nullptr) {
+                break;
+            }
 
-                if (offset < 0) continue; // The event is outside of the current block
-
-                // Generate note-off MIDI events
-                for (auto i : event.offs) {
-                    auto &data = events.data[i];
-                    if (data.lastNote.noteNumber >= 0) {
-                        midi.addEvent(juce::MidiMessage::noteOff(data.lastNote.outChannel, data.lastNote.noteNumber), offset);
-                        setNoteNotPlaying(data.lastNote.outChannel, data.lastNote.noteNumber);
-                        data.lastNote = ArpBuiltEvents::PlayingNote(-1, -1);
-                    }
-                }
+            processInputMidi(input, inputEnd, next->nextEventOffset, isHostPlaying, nonPlayingMode);
 
-                if (inputNotes.isEmpty()) continue;
-
-                // Max chord size processing
-                int chordSize;
-                int indexOffset;
-                if (maxChordSize->get() == 0) {
-                    chordSize = inputNotes.size();
-                    indexOffset = 0;
-                } else {
-                    chordSize = *maxChordSize;
-                    indexOffset = (chordSize < inputNotes.size() && extraNotesSelectionMode->getIndex() == FROM_TOP)
-                        ? inputNotes.size() - chordSize
-                        : 0;
-                }
+            numScannedEvents++;
+            processLayerEvent(*next);
+            advanceLayer(*next, numSamples);
+        }
+        processInputMidi(input, inputEnd, std::numeric_limits<int>::max(), isHostPlaying, nonPlayingMode);
 
-                // Generate note-on MIDI events
-                for (auto i : event.ons) {
-                    auto &data = events.data[i];
-                    auto index = data.noteNumber % chordSize;
-                    if (index < 0)
-                        index += inputNotes.size();
-                    index += indexOffset;
-
-                    if (index > inputNotes.size()) {
-                        // There is no sound for us right now, skip it
-                        data.lastNote = ArpBuiltEvents::PlayingNote(-1, -1);
-                        continue;
-                    }
-
-                    auto note = inputNotes[index].note;
-                    auto velocity = (*usingInputVelocity)
-                            ? inputNotes[index].velocity * data.velocity * 1.25
-                            : data.velocity;
-
-                    // Transposition
-                    if (*octaves) {
-                        auto octNn = (data.noteNumber >= 0) ? data.noteNumber : data.noteNumber + 1;
-                        auto octave = octNn / chordSize;
-                        if (data.noteNumber < 0) {
-                            octave--;
-                        }
-                        note += (*smartOctaves)
-                                ? octave * smartOctaveNumber * NOTES_IN_OCTAVE
-                                : octave * NOTES_IN_OCTAVE;
-                    }
-
-                    if (juce::isPositiveAndBelow(note, 128) && data.lastNote.noteNumber != note) {
-                        data.lastNote = ArpBuiltEvents::PlayingNote(note, outputMidiChannel);
-                        midi.addEvent(juce::MidiMessage::noteOn(
-                                    data.lastNote.outChannel,
-                                    data.lastNote.noteNumber,
-                                    static_cast<float>(velocity)), offset);
-                        setNotePlaying(data.lastNote.outChannel, data.lastNote.noteNumber);
-                    }
-                }
-            }
+        auto numInputNotes = getNumFedInputNotes();
+        int newOctaveSize = octaveSize;
+        if (maxChordSize->get() != 0)
+            newOctaveSize = maxChordSize->get();
+        else if (numInputNotes != 0)
+            newOctaveSize = numInputNotes;
+        if (newOctaveSize != octaveSize) {
+            octaveSize = newOctaveSize;
+            stateChanged();
         }
 
-        this->lastPosition = blockEndPosition;
         this->wasPlaying = true;
         updateEditor();
     } else {
+        processInputMidi(input, inputEnd, std::numeric_limits<int>::max(), isHostPlaying, nonPlayingMode);
         updateEditor();
 
         if (this->wasPlaying) {
-            this->stopAll(midi);
+            this->stopAll(outputMidi);
         }
 
-        this->lastPosition = 0;
+        for (int i = 0; i < numLayers; i++) {
+            layers[i]->lastPosition = 0;
+            layers[i]->scheduler.reset();
+        }
         this->wasPlaying = false;
     }
 
-    this->lastNumInputNotes = this->inputNotes.size();
-    this->lastSwing = *this->swing;
+    for (int i = 0; i < numLayers; i++) {
+        layers[i]->lastSwing = getLayerParameters(i).swing;
+    }
+
+    auto numOutputEvents = static_cast<uint32_t>(outputMidi.size());
+    outputMidi.flushTo(midi);
+
+    auto elapsedTicks = juce::Time::getHighResolutionTicks() - startTicks;
+    auto elapsedNanos = static_cast<double>(elapsedTicks) * 1e9
+            / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    auto realtimeNanos = (getSampleRate() > 0.0) ? numSamples * 1e9 / getSampleRate() : 0.0;
+    performanceStats.record(
+            static_cast<uint64_t>(elapsedNanos),
+            realtimeNanos,
+            numOutputEvents,
+            numScannedEvents);
+}
+
+void LibreArp::beginLayerBlock(Layer &layer,
+                               const LayerParameters &parameters,
+                               const juce::AudioPlayHead::CurrentPositionInfo &cpi,
+                               int numSamples) {
+    layer.hasNextEvent = false;
+    layer.blockParameters = parameters;
+
+    auto &table = *layer.events->table;
+    if (table.events.empty() || table.loopLength <= 0) {
+        layer.lastPosition = 0;
+        return;
+    }
+
+    auto timebase = table.timebase;
+    layer.timeline.update(getSampleRate(), cpi.bpm, timebase);
+
+    // Current position in pattern-space, in fixed-point pulses
+    auto baseBlockStartPosition = layer.timeline.ppqToPosition(cpi.ppqPosition - this->patternOffset);
+    auto offsadd = PulseTimeline::fromPulses((this->loopReset > 0)
+        ? static_cast<int64_t>(this->loopReset * timebase)
+        : table.loopLength);
+    if (baseBlockStartPosition < 0 && offsadd > 0)
+        baseBlockStartPosition = baseBlockStartPosition % offsadd + offsadd;
+
+    auto baseBlockEndPosition = baseBlockStartPosition + layer.timeline.samplesToDuration(numSamples);
+
+    // The block in swung pattern-space; events inside of it are spread linearly over its samples
+    auto &grooveTable = *layer.events->groove;
+    auto swungBlockStart = PulseTimeline::fromDouble(
+            grooveTable.warp(PulseTimeline::toDouble(baseBlockStartPosition), layer.lastSwing));
+    auto swungBlockEnd = PulseTimeline::fromDouble(
+            grooveTable.warp(PulseTimeline::toDouble(baseBlockEndPosition), parameters.swing));
+    layer.swungBlockStart = swungBlockStart;
+    layer.swungBlockLength = std::max(int64_t(1), swungBlockEnd - swungBlockStart);
+    auto blockStartPosition = PulseTimeline::ceilToPulses(swungBlockStart);
+    auto blockEndPosition = PulseTimeline::ceilToPulses(swungBlockEnd);
+
+    auto loopResetLength = (this->loopReset > 0.0)
+        ? static_cast<int64_t>(std::ceil(timebase * this->loopReset))
+        : 0;
+    layer.scheduler.beginBlock(table, loopResetLength, blockStartPosition, blockEndPosition);
+
+    layer.outputNoteSettings = getOutputNoteSettings(parameters);
+    layer.lastPosition = blockEndPosition;
+    advanceLayer(layer, numSamples);
+}
+
+void LibreArp::advanceLayer(Layer &layer, int numSamples) {
+    layer.hasNextEvent = layer.scheduler.next(layer.nextEventIndex, layer.nextEventTime);
+    if (layer.hasNextEvent) {
+        layer.nextEventOffset = PulseTimeline::sampleOffset(
+                layer.nextEventTime, layer.swungBlockStart, layer.swungBlockLength, numSamples);
+    }
+}
+
+void LibreArp::processLayerEvent(Layer &layer) {
+    auto &events = *layer.events;
+    auto &table = *events.table;
+    auto &event = table.events[layer.nextEventIndex];
+    auto time = layer.nextEventTime;
+    auto offset = layer.nextEventOffset;
+
+    auto &data = table.data;
+    auto &lastNotes = events.lastNotes;
+
+    // Generate note-off MIDI events
+    for (auto o = event.offsOffset; o < event.offsOffset + event.offsCount; o++) {
+        auto i = table.offs[o];
+        auto &lastNote = lastNotes[i];
+        if (lastNote.noteNumber >= 0) {
+            outputMidi.add(juce::MidiMessage::noteOff(lastNote.outChannel, lastNote.noteNumber), offset);
+            activeNotes.noteOff(lastNote.outChannel, lastNote.noteNumber);
+            events.clearLastNote(i);
+        }
+    }
+
+    if (inputChord.isEmpty()) {
+        return;
+    }
+
+    // The chord may have changed since the previous event
+    auto &outputNotes = events.outputNotes;
+    auto &outputNoteSettings = layer.outputNoteSettings;
+    if (!outputNotes.isUpToDate(outputNoteSettings)) {
+        outputNotes.fill(outputNoteSettings, [this, &outputNoteSettings](int noteNumber) {
+            return mapOutputNote(noteNumber, outputNoteSettings);
+        });
+    }
+
+    // Generate note-on MIDI events
+    auto &grooveTable = *events.groove;
+    for (auto o = event.onsOffset; o < event.onsOffset + event.onsCount; o++) {
+        auto i = table.ons[o];
+        auto &output = outputNotes.get(data.noteNumbers[i]);
+        auto &lastNote = lastNotes[i];
+
+        if (output.skipped) {
+            // There is no sound for us right now, skip it
+            events.clearLastNote(i);
+            continue;
+        }
+
+        if (output.note >= 0 && lastNote.noteNumber != output.note) {
+            auto velocity = data.velocities[i] * output.velocityScale;
+            if (grooveTable.hasVelocities()) {
+                velocity = juce::jmin(1.0,
+                        velocity * grooveTable.getVelocityMultiplier(time, layer.blockParameters.swing));
+            }
+
+            // A note-on that does not fit in the output is not tracked, so that no note-off is sent for it
+            auto channel = layer.blockParameters.outputMidiChannel;
+            if (outputMidi.add(juce::MidiMessage::noteOn(channel, output.note, static_cast<float>(velocity)), offset)) {
+                events.setLastNote(i, ArpBuiltEvents::PlayingNote(output.note, channel));
+                activeNotes.noteOn(channel, output.note);
+            }
+        }
+    }
 }
 
 //==============================================================================
@@ -389,132 +621,498 @@ juce::AudioProcessorEditor *LibreArp::createEditor() {
 }
 
 void LibreArp::getStateInformation(juce::MemoryBlock &destData) {
+    std::scoped_lock lock(savedStateMutex);
+
+    // Hosts ask for the state on every autosave and undo step, mostly with nothing changed since the last time
+    auto generation = this->stateGeneration.load();
+    if (generation != this->savedStateGeneration || !this->editorState.isSavedEqual(this->savedEditorState)) {
+        this->savedEditorState = this->editorState;
+        writeState(this->savedState);
+        this->savedStateGeneration = generation;
+    }
+    destData = this->savedState;
+}
+
+void LibreArp::writeState(juce::MemoryBlock &destData) {
     destData.reset();
-    juce::MemoryOutputStream(destData, true).writeString(toValueTree().toXmlString());
+    juce::MemoryOutputStream out(destData, false);
+    out.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+    out.writeInt(STATE_VERSION);
+
+    writeStateSection(out, STATE_SECTION_PROPERTIES, [this](juce::OutputStream &section) {
+        toValueTree(false).writeToStream(section);
+    });
+
+    auto numLayers = this->numLayers.load();
+    for (int i = 0; i < numLayers; i++) {
+        writeStateSection(out, STATE_SECTION_PATTERN, [this, i](juce::OutputStream &section) {
+            this->layers[i]->pattern.toStream(section);
+        });
+    }
 }
 
 void LibreArp::setStateInformation(const void *data, int sizeInBytes) {
     if (sizeInBytes > 0) {
-        juce::String xml = juce::MemoryInputStream(data, static_cast<size_t>(sizeInBytes), false).readString();
-        std::unique_ptr<juce::XmlElement> doc = juce::XmlDocument::parse(xml);
-        juce::ValueTree tree = juce::ValueTree::fromXml(*doc);
+        juce::MemoryInputStream in(data, static_cast<size_t>(sizeInBytes), false);
+        if (static_cast<size_t>(sizeInBytes) >= sizeof(STATE_MAGIC)
+                && std::memcmp(data, STATE_MAGIC, sizeof(STATE_MAGIC)) == 0) {
+            loadBinaryState(in);
+        } else {
+            loadXmlState(in);
+        }
+    }
+}
 
-        if (tree.isValid() && tree.hasType(TREEID_LIBREARP)) {
-            juce::ValueTree patternTree = tree.getChildWithName(ArpPattern::TREEID_PATTERN);
-            ArpPattern loadedPattern = ArpPattern::fromValueTree(patternTree);
+void LibreArp::loadBinaryState(juce::InputStream &in) {
+    in.skipNextBytes(sizeof(STATE_MAGIC));
+    if (in.readInt() > STATE_VERSION) {
+        return; // Saved by an incompatible future version
+    }
 
-            juce::ValueTree editorTree = tree.getChildWithName(EditorState::TREEID_EDITOR_STATE);
-            if (editorTree.isValid()) {
-                this->editorState = EditorState::fromValueTree(editorTree);
-            }
-            if (tree.hasProperty(TREEID_LOOP_RESET)) {
-                this->loopReset = tree.getProperty(TREEID_LOOP_RESET);
-            }
-            if (tree.hasProperty(TREEID_OCTAVES)) {
-                *this->octaves = tree.getProperty(TREEID_OCTAVES);
-            }
-            if (tree.hasProperty(TREEID_SMART_OCTAVES)) {
-                *this->smartOctaves = tree.getProperty(TREEID_SMART_OCTAVES);
-            } else {
-                // Backwards compatibility: do not change behaviour of old instances
-                *this->smartOctaves = false;
-            }
-            if (tree.hasProperty(TREEID_INPUT_VELOCITY)) {
-                *this->usingInputVelocity = tree.getProperty(TREEID_INPUT_VELOCITY);
-            }
-            if (tree.hasProperty(TREEID_SWING)) {
-                *this->swing = tree.getProperty(TREEID_SWING);
-                this->lastSwing = *this->swing;
-            }
-            if (tree.hasProperty(TREEID_MAX_CHORD_SIZE)) {
-                *this->maxChordSize = tree.getProperty(TREEID_MAX_CHORD_SIZE);
-            }
-            if (tree.hasProperty(TREEID_EXTRA_NOTES_SELECTION_MODE)) {
-                *this->extraNotesSelectionMode = tree.getProperty(TREEID_EXTRA_NOTES_SELECTION_MODE);
-            }
-            if (tree.hasProperty(TREEID_NUM_INPUT_NOTES)) {
-                this->octaveSize = tree.getProperty(TREEID_NUM_INPUT_NOTES);
-            }
-            if (tree.hasProperty(TREEID_OUTPUT_MIDI_CHANNEL)) {
-                this->outputMidiChannel = tree.getProperty(TREEID_OUTPUT_MIDI_CHANNEL);
-            }
-            if (tree.hasProperty(TREEID_INPUT_MIDI_CHANNEL)) {
-                this->inputMidiChannel = tree.getProperty(TREEID_INPUT_MIDI_CHANNEL);
-            }
-            if (tree.hasProperty(TREEID_NON_PLAYING_MODE_OVERRIDE)) {
-                this->nonPlayingModeOverride = NonPlayingMode::of(tree.getProperty(TREEID_NON_PLAYING_MODE_OVERRIDE));
-            }
-            if (tree.hasProperty(TREEID_BYPASS)) {
-                *this->bypass = tree.getProperty(TREEID_BYPASS);
-            }
-            if (tree.hasProperty(TREEID_PATTERN_OFFSET)) {
-                this->patternOffset = static_cast<juce::int64>(tree.getProperty(TREEID_PATTERN_OFFSET));
-            }
-            if (tree.hasProperty(TREEID_USER_TIME_SIG)) {
-                this->userTimeSig = tree.getProperty(TREEID_USER_TIME_SIG);
-            }
-            if (tree.hasProperty(TREEID_USER_TIME_SIG_NUMERATOR)) {
-                this->userTimeSigNumerator = tree.getProperty(TREEID_USER_TIME_SIG_NUMERATOR);
-            }
-            if (tree.hasProperty(TREEID_USER_TIME_SIG_DENOMINATOR)) {
-                this->userTimeSigDenominator = tree.getProperty(TREEID_USER_TIME_SIG_DENOMINATOR);
-            }
+    juce::ValueTree tree;
+    std::array<ArpPattern, MAX_LAYERS> patterns;
+    size_t numPatterns = 0;
+    while (in.getNumBytesRemaining() >= STATE_SECTION_HEADER_SIZE) {
+        auto type = in.readInt();
+        auto size = in.readInt();
+        if (size < 0 || size > in.getNumBytesRemaining()) {
+            break;
+        }
+
+        auto sectionEnd = in.getPosition() + size;
+        juce::SubregionStream section(&in, in.getPosition(), size, false);
+        if (type == STATE_SECTION_PROPERTIES) {
+            tree = juce::ValueTree::readFromStream(section);
+        } else if (type == STATE_SECTION_PATTERN && numPatterns < patterns.size()) {
+            patterns[numPatterns++] = ArpPattern::fromStream(section);
+        }
+        in.setPosition(sectionEnd);
+    }
+
+    loadState(tree, patterns);
+}
+
+void LibreArp::loadXmlState(juce::InputStream &in) {
+    std::unique_ptr<juce::XmlElement> doc = juce::XmlDocument::parse(in.readString());
+    if (doc == nullptr) {
+        return;
+    }
+    juce::ValueTree tree = juce::ValueTree::fromXml(*doc);
+
+    // The patterns are stored inside of the tree in this format
+    std::array<ArpPattern, MAX_LAYERS> patterns;
+    juce::ValueTree patternTree = tree.getChildWithName(ArpPattern::TREEID_PATTERN);
+    patterns[0] = ArpPattern::fromValueTree(patternTree);
+    size_t numPatterns = 1;
+    juce::ValueTree layersTree = tree.getChildWithName(TREEID_LAYERS);
+    for (auto layerTree : layersTree) {
+        if (numPatterns >= patterns.size() || !layerTree.hasType(TREEID_LAYER)) {
+            continue;
+        }
+
+        juce::ValueTree layerPatternTree = layerTree.getChildWithName(ArpPattern::TREEID_PATTERN);
+        patterns[numPatterns++] = ArpPattern::fromValueTree(layerPatternTree);
+    }
+
+    loadState(tree, patterns);
+}
+
+void LibreArp::loadState(const juce::ValueTree &tree, std::array<ArpPattern, MAX_LAYERS> &patterns) {
+    if (!tree.isValid() || !tree.hasType(TREEID_LIBREARP)) {
+        return;
+    }
+
+    // Prepare everything the audio thread needs before touching anything, so that it can switch over in one go
+    juce::ValueTree grooveTree = tree.getChildWithName(GrooveTemplate::TREEID_GROOVE);
+    GrooveTemplate loadedGroove = grooveTree.isValid()
+            ? GrooveTemplate::fromValueTree(grooveTree)
+            : GrooveTemplate::sine();
+
+    // Settings missing from the tree keep their current values
+    auto restored = std::make_unique<RestoredState>();
+    auto &settings = restored->settings;
+    settings = getRestoredSettings();
+
+    // Layers other than the first one; their absence means there is only one layer
+    int loadedLayers = 1;
+    juce::ValueTree layersTree = tree.getChildWithName(TREEID_LAYERS);
+    for (auto layerTree : layersTree) {
+        if (loadedLayers >= MAX_LAYERS || !layerTree.hasType(TREEID_LAYER)) {
+            continue;
+        }
+
+        auto &parameters = settings.layerParameters[static_cast<size_t>(loadedLayers)];
+        parameters.outputMidiChannel = layerTree.getProperty(TREEID_OUTPUT_MIDI_CHANNEL, 1);
+        parameters.octaves = layerTree.getProperty(TREEID_OCTAVES, true);
+        parameters.smartOctaves = layerTree.getProperty(TREEID_SMART_OCTAVES, true);
+        parameters.swing = layerTree.getProperty(TREEID_SWING, 0.0f);
+        loadedLayers++;
+    }
+
+    std::array<std::shared_ptr<const ArpBuiltEvents>, MAX_LAYERS> builtEvents;
+    std::array<std::shared_ptr<const GrooveTable>, MAX_LAYERS> grooveTables;
+    for (size_t i = 0; i < MAX_LAYERS; i++) {
+        if (static_cast<int>(i) < loadedLayers) {
+            builtEvents[i] = ArpBuiltEventsCache::getInstance().get(patterns[i]);
+        } else {
+            builtEvents[i] = std::make_shared<ArpBuiltEvents>();
+        }
+        grooveTables[i] = std::make_shared<GrooveTable>(loadedGroove, builtEvents[i]->timebase);
+        restored->events[i] = std::make_unique<PlayingEvents>(builtEvents[i], grooveTables[i]);
+    }
+    if (tree.hasProperty(TREEID_PATTERN_OFFSET_QUARTERS)) {
+        restored->patternOffset = tree.getProperty(TREEID_PATTERN_OFFSET_QUARTERS);
+    } else if (tree.hasProperty(TREEID_PATTERN_OFFSET) && patterns[0].getTimebase() > 0) {
+        // Backwards compatibility: older versions stored the offset in pulses of the (only) pattern
+        restored->patternOffset = static_cast<double>(static_cast<juce::int64>(tree.getProperty(TREEID_PATTERN_OFFSET)))
+                / patterns[0].getTimebase();
+    }
+
+    if (tree.hasProperty(TREEID_LOOP_RESET)) {
+        settings.loopReset = tree.getProperty(TREEID_LOOP_RESET);
+    }
+    if (tree.hasProperty(TREEID_NUM_INPUT_NOTES)) {
+        settings.octaveSize = tree.getProperty(TREEID_NUM_INPUT_NOTES);
+    }
+    if (tree.hasProperty(TREEID_OUTPUT_MIDI_CHANNEL)) {
+        settings.layerParameters[0].outputMidiChannel = tree.getProperty(TREEID_OUTPUT_MIDI_CHANNEL);
+    }
+    if (tree.hasProperty(TREEID_INPUT_MIDI_CHANNEL)) {
+        settings.inputMidiChannel = tree.getProperty(TREEID_INPUT_MIDI_CHANNEL);
+    }
+    if (tree.hasProperty(TREEID_NON_PLAYING_MODE_OVERRIDE)) {
+        settings.nonPlayingModeOverride = NonPlayingMode::of(tree.getProperty(TREEID_NON_PLAYING_MODE_OVERRIDE));
+    }
+
+    // Apply the rest of the state on this thread. Host parameters cannot wait for the audio thread, since the host may
+    // read them back right away, so they switch over on their own.
+    juce::ValueTree editorTree = tree.getChildWithName(EditorState::TREEID_EDITOR_STATE);
+    if (editorTree.isValid()) {
+        this->editorState = EditorState::fromValueTree(editorTree);
+    }
+    if (tree.hasProperty(TREEID_OCTAVES)) {
+        *this->octaves = tree.getProperty(TREEID_OCTAVES);
+    }
+    if (tree.hasProperty(TREEID_SMART_OCTAVES)) {
+        *this->smartOctaves = tree.getProperty(TREEID_SMART_OCTAVES);
+    } else {
+        // Backwards compatibility: do not change behaviour of old instances
+        *this->smartOctaves = false;
+    }
+    if (tree.hasProperty(TREEID_INPUT_VELOCITY)) {
+        *this->usingInputVelocity = tree.getProperty(TREEID_INPUT_VELOCITY);
+    }
+    this->groove = loadedGroove;
+    if (tree.hasProperty(TREEID_SWING)) {
+        *this->swing = tree.getProperty(TREEID_SWING);
+    }
+    if (tree.hasProperty(TREEID_MAX_CHORD_SIZE)) {
+        *this->maxChordSize = tree.getProperty(TREEID_MAX_CHORD_SIZE);
+    }
+    if (tree.hasProperty(TREEID_EXTRA_NOTES_SELECTION_MODE)) {
+        *this->extraNotesSelectionMode = tree.getProperty(TREEID_EXTRA_NOTES_SELECTION_MODE);
+    }
+    if (tree.hasProperty(TREEID_BYPASS)) {
+        *this->bypass = tree.getProperty(TREEID_BYPASS);
+    }
+    if (tree.hasProperty(TREEID_USER_TIME_SIG)) {
+        this->userTimeSig = tree.getProperty(TREEID_USER_TIME_SIG);
+    }
+    if (tree.hasProperty(TREEID_USER_TIME_SIG_NUMERATOR)) {
+        this->userTimeSigNumerator = tree.getProperty(TREEID_USER_TIME_SIG_NUMERATOR);
+    }
+    if (tree.hasProperty(TREEID_USER_TIME_SIG_DENOMINATOR)) {
+        this->userTimeSigDenominator = tree.getProperty(TREEID_USER_TIME_SIG_DENOMINATOR);
+    }
+
+    for (size_t i = 0; i < MAX_LAYERS; i++) {
+        auto &layer = *this->layers[i];
+        auto index = static_cast<int>(i);
+        if (index < loadedLayers) {
+            layer.pattern = patterns[i];
+        }
+        layer.builtEvents = builtEvents[i];
+        layer.grooveTable = grooveTables[i];
+
+        // Events built before the restore must not be picked up after it
+        delete layer.pendingEvents.exchange(nullptr);
+    }
 
-            setPattern(loadedPattern);
+    // Hand the prepared events and settings over to the audio thread. It reads the number of layers before picking them
+    // up, so they are published first; whichever number it reads, it never plays events from before the restore
+    // afterwards.
+    {
+        // The last saved state is written from the pending state until it is switched to, so the pending state is not
+        // replaced while the saved state is being written
+        std::scoped_lock lock(savedStateMutex);
+        deleteRetiredState();
+        delete this->pendingState.exchange(restored.release());
+        if (!this->prepared) {
+            // No blocks are processed, so there is nothing to wait for
+            applyRestoredState(this->outputMidi);
+            deleteRetiredState();
         }
     }
+    this->numLayers = loadedLayers;
+    this->editedLayer = juce::jlimit(
+            0, loadedLayers - 1, static_cast<int>(tree.getProperty(TREEID_EDITED_LAYER, 0)));
+    this->restoreGeneration++;
+    stateChanged();
+    updateEditor();
 }
 
-juce::ValueTree LibreArp::toValueTree() {
+juce::ValueTree LibreArp::toValueTree(bool withPatterns) {
+    // A restored state the audio thread has not switched to yet is saved as restored
+    auto pending = this->pendingState.load();
+    auto settings = (pending != nullptr) ? pending->settings : getRestoredSettings();
+    auto patternOffset = (pending != nullptr) ? pending->patternOffset : this->patternOffset.load();
+
     juce::ValueTree tree = juce::ValueTree(TREEID_LIBREARP);
-    tree.appendChild(this->pattern.toValueTree(), nullptr);
+    if (withPatterns) {
+        tree.appendChild(this->layers[0]->pattern.toValueTree(), nullptr);
+    }
     tree.appendChild(this->editorState.toValueTree(), nullptr);
-    tree.setProperty(TREEID_LOOP_RESET, this->loopReset.load(), nullptr);
-    tree.setProperty(TREEID_PATTERN_XML, this->patternXml, nullptr);
+    tree.appendChild(this->groove.toValueTree(), nullptr);
+    tree.setProperty(TREEID_LOOP_RESET, settings.loopReset, nullptr);
     tree.setProperty(TREEID_OCTAVES, this->octaves->get(), nullptr);
     tree.setProperty(TREEID_SMART_OCTAVES, this->smartOctaves->get(), nullptr);
     tree.setProperty(TREEID_INPUT_VELOCITY, this->usingInputVelocity->get(), nullptr);
     tree.setProperty(TREEID_SWING, this->swing->get(), nullptr);
     tree.setProperty(TREEID_MAX_CHORD_SIZE, this->maxChordSize->get(), nullptr);
     tree.setProperty(TREEID_EXTRA_NOTES_SELECTION_MODE, this->extraNotesSelectionMode->getIndex(), nullptr);
-    tree.setProperty(TREEID_NUM_INPUT_NOTES, this->octaveSize, nullptr);
-    tree.setProperty(TREEID_OUTPUT_MIDI_CHANNEL, this->outputMidiChannel, nullptr);
-    tree.setProperty(TREEID_INPUT_MIDI_CHANNEL, this->inputMidiChannel, nullptr);
-    tree.setProperty(TREEID_NON_PLAYING_MODE_OVERRIDE, NonPlayingMode::toJuceString(this->nonPlayingModeOverride), nullptr);
+    tree.setProperty(TREEID_NUM_INPUT_NOTES, settings.octaveSize, nullptr);
+    tree.setProperty(TREEID_OUTPUT_MIDI_CHANNEL, settings.layerParameters[0].outputMidiChannel, nullptr);
+    tree.setProperty(TREEID_INPUT_MIDI_CHANNEL, settings.inputMidiChannel, nullptr);
+    tree.setProperty(TREEID_NON_PLAYING_MODE_OVERRIDE, NonPlayingMode::toJuceString(settings.nonPlayingModeOverride), nullptr);
     tree.setProperty(TREEID_BYPASS, this->bypass->get(), nullptr);
-    tree.setProperty(TREEID_PATTERN_OFFSET, static_cast<juce::int64>(this->patternOffset), nullptr);
+    tree.setProperty(TREEID_PATTERN_OFFSET_QUARTERS, patternOffset, nullptr);
     tree.setProperty(TREEID_USER_TIME_SIG, this->userTimeSig, nullptr);
     tree.setProperty(TREEID_USER_TIME_SIG_NUMERATOR, this->userTimeSigNumerator, nullptr);
     tree.setProperty(TREEID_USER_TIME_SIG_DENOMINATOR, this->userTimeSigDenominator, nullptr);
+    tree.setProperty(TREEID_EDITED_LAYER, this->editedLayer, nullptr);
+
+    auto numLayers = this->numLayers.load();
+    if (numLayers > 1) {
+        juce::ValueTree layersTree = juce::ValueTree(TREEID_LAYERS);
+        for (int i = 1; i < numLayers; i++) {
+            auto &parameters = settings.layerParameters[static_cast<size_t>(i)];
+            juce::ValueTree layerTree = juce::ValueTree(TREEID_LAYER);
+            if (withPatterns) {
+                layerTree.appendChild(this->layers[i]->pattern.toValueTree(), nullptr);
+            }
+            layerTree.setProperty(TREEID_OUTPUT_MIDI_CHANNEL, parameters.outputMidiChannel, nullptr);
+            layerTree.setProperty(TREEID_OCTAVES, parameters.octaves, nullptr);
+            layerTree.setProperty(TREEID_SMART_OCTAVES, parameters.smartOctaves, nullptr);
+            layerTree.setProperty(TREEID_SWING, parameters.swing, nullptr);
+            layersTree.appendChild(layerTree, nullptr);
+        }
+        tree.appendChild(layersTree, nullptr);
+    }
     return tree;
 }
 
+uint64_t LibreArp::getRestoreGeneration() const {
+    return this->restoreGeneration;
+}
+
 void LibreArp::setPattern(const ArpPattern &newPattern) {
-    this->pattern = newPattern;
+    getPattern() = newPattern;
     buildPattern();
 }
 
-void LibreArp::loadPatternFromFile(const juce::File &file) {
-    setPattern(ArpPattern::fromFile(file));
+bool LibreArp::loadPatternFromFile(const juce::File &file) {
+    bool success;
+    auto pattern = ArpPattern::fromFile(file, &success);
+    if (!success) {
+        return false;
+    }
+
+    setPattern(pattern);
+    return true;
 }
 
 void LibreArp::buildPattern() {
-    this->buildScheduled = true;
+    buildLayer(*layers[editedLayer]);
+}
+
+void LibreArp::buildPattern(const std::vector<size_t> &changedNotes) {
+    buildLayer(*layers[editedLayer], changedNotes);
+}
+
+void LibreArp::buildLayer(Layer &layer) {
+    stateChanged();
+
+    auto &pattern = layer.pattern;
+    pattern.notesChanged();
+    layer.builtEvents = ArpBuiltEventsCache::getInstance().get(pattern);
+    layer.grooveTable = std::make_shared<GrooveTable>(groove, layer.builtEvents->timebase);
+    auto built = std::make_unique<PlayingEvents>(layer.builtEvents, layer.grooveTable);
+    delete layer.pendingEvents.exchange(built.release());
+    deleteRetiredEvents(layer);
+}
+
+void LibreArp::buildLayer(Layer &layer, const std::vector<size_t> &changedNotes) {
+    stateChanged();
+
+    auto &pattern = layer.pattern;
+    if (layer.builtEvents == nullptr || layer.grooveTable == nullptr || !pattern.isPatchableFrom(*layer.builtEvents)) {
+        buildLayer(layer);
+        return;
+    }
+
+    pattern.notesChanged(changedNotes);
+    layer.builtEvents = std::make_shared<ArpBuiltEvents>(pattern.buildEvents(*layer.builtEvents, changedNotes));
+
+    // The timebase has not changed, so neither has the groove table
+    auto built = std::make_unique<PlayingEvents>(layer.builtEvents, layer.grooveTable);
+    built->markEdited(changedNotes);
+
+    // If the previous events have not been picked up yet, the audio thread is still playing the ones before them, so
+    // the edits need to be combined
+    std::unique_ptr<PlayingEvents> replaced(layer.pendingEvents.exchange(nullptr));
+    if (replaced != nullptr) {
+        built->mergeEdits(*replaced);
+    }
+
+    layer.pendingEvents.store(built.release());
+    deleteRetiredEvents(layer);
 }
 
 ArpPattern &LibreArp::getPattern() {
-    return this->pattern;
+    return this->layers[editedLayer]->pattern;
 }
 
 
 int64_t LibreArp::getLastPosition() {
-    return this->lastPosition;
+    return this->layers[editedLayer]->lastPosition;
+}
+
+
+int LibreArp::getNumLayers() const {
+    return this->numLayers;
+}
+
+int LibreArp::addLayer() {
+    auto index = this->numLayers.load();
+    if (index >= MAX_LAYERS) {
+        return -1;
+    }
+
+    // The new layer is not played until it is counted, so it can be set up freely
+    auto &layer = *this->layers[index];
+    layer.pattern = ArpPattern();
+    layer.lastSwing = 0.0f;
+    setLayerParameters(index, getLayerParameters(this->editedLayer));
+    buildLayer(layer);
+
+    this->numLayers = index + 1;
+    this->editedLayer = index;
+    stateChanged();
+    updateEditor();
+    return index;
+}
+
+void LibreArp::removeLayer(int index) {
+    auto numLayers = this->numLayers.load();
+    if (numLayers <= 1 || !juce::isPositiveAndBelow(index, numLayers)) {
+        return;
+    }
+
+    // Shift the following layers down; each one is rebuilt, which stops its playing notes
+    for (int i = index; i < numLayers - 1; i++) {
+        this->layers[i]->pattern = this->layers[i + 1]->pattern;
+        setLayerParameters(i, getLayerParameters(i + 1));
+        buildLayer(*this->layers[i]);
+    }
+
+    // The notes of the dropped layer are no longer visited by the audio thread, so everything needs to be stopped
+    this->numLayers = numLayers - 1;
+    this->editedLayer = juce::jmin(this->editedLayer, numLayers - 2);
+    this->stopAll();
+    stateChanged();
+    updateEditor();
+}
+
+int LibreArp::getEditedLayer() const {
+    return this->editedLayer;
+}
+
+void LibreArp::setEditedLayer(int index) {
+    this->editedLayer = juce::jlimit(0, this->numLayers - 1, index);
+    stateChanged();
+    updateEditor();
+}
+
+LibreArp::LayerParameters LibreArp::getLayerParameters(int index) const {
+    auto &layer = *this->layers[index];
+
+    LayerParameters parameters;
+    parameters.outputMidiChannel = layer.outputMidiChannel;
+    if (index == 0) {
+        parameters.octaves = this->octaves->get();
+        parameters.smartOctaves = this->smartOctaves->get();
+        parameters.swing = this->swing->get();
+    } else {
+        parameters.octaves = layer.octaves;
+        parameters.smartOctaves = layer.smartOctaves;
+        parameters.swing = layer.swing;
+    }
+    return parameters;
+}
+
+void LibreArp::setLayerParameters(int index, const LayerParameters &parameters) {
+    auto &layer = *this->layers[index];
+
+    layer.outputMidiChannel = parameters.outputMidiChannel;
+    if (index == 0) {
+        *this->octaves = parameters.octaves;
+        *this->smartOctaves = parameters.smartOctaves;
+        *this->swing = parameters.swing;
+    } else {
+        layer.octaves = parameters.octaves;
+        layer.smartOctaves = parameters.smartOctaves;
+        layer.swing = parameters.swing;
+    }
+    stateChanged();
+}
+
+LibreArp::RestoredSettings LibreArp::getRestoredSettings() const {
+    RestoredSettings settings;
+    settings.loopReset = this->loopReset;
+    settings.octaveSize = this->octaveSize;
+    settings.inputMidiChannel = this->inputMidiChannel;
+    settings.nonPlayingModeOverride = this->nonPlayingModeOverride;
+    for (size_t i = 0; i < MAX_LAYERS; i++) {
+        auto &layer = *this->layers[i];
+        auto &parameters = settings.layerParameters[i];
+        parameters.outputMidiChannel = layer.outputMidiChannel;
+        parameters.octaves = layer.octaves;
+        parameters.smartOctaves = layer.smartOctaves;
+        parameters.swing = layer.swing;
+    }
+    return settings;
+}
+
+void LibreArp::setRestoredSettings(const RestoredSettings &settings) {
+    this->loopReset = settings.loopReset;
+    this->octaveSize = settings.octaveSize;
+    this->inputMidiChannel = settings.inputMidiChannel;
+    this->nonPlayingModeOverride = settings.nonPlayingModeOverride;
+    for (size_t i = 0; i < MAX_LAYERS; i++) {
+        auto &layer = *this->layers[i];
+        auto &parameters = settings.layerParameters[i];
+        layer.outputMidiChannel = parameters.outputMidiChannel;
+        layer.octaves = parameters.octaves;
+        layer.smartOctaves = parameters.smartOctaves;
+        layer.swing = parameters.swing;
+    }
 }
 
 
 
 void LibreArp::setLoopReset(double beats) {
     this->loopReset = juce::jmax(0.0, beats);
+    stateChanged();
 }
 
 double LibreArp::getLoopReset() const {
@@ -523,19 +1121,23 @@ double LibreArp::getLoopReset() const {
 
 
 bool LibreArp::isTransposingOctaves() {
-    return *this->octaves;
+    return getLayerParameters(editedLayer).octaves;
 }
 
 void LibreArp::setTransposingOctaves(bool value) {
-    *this->octaves = value;
+    auto parameters = getLayerParameters(editedLayer);
+    parameters.octaves = value;
+    setLayerParameters(editedLayer, parameters);
 }
 
 bool LibreArp::isUsingSmartOctaves() {
-    return *this->smartOctaves;
+    return getLayerParameters(editedLayer).smartOctaves;
 }
 
 void LibreArp::setUsingSmartOctaves(bool value) {
-    *this->smartOctaves = value;
+    auto parameters = getLayerParameters(editedLayer);
+    parameters.smartOctaves = value;
+    setLayerParameters(editedLayer, parameters);
 }
 
 bool LibreArp::isUsingInputVelocity() {
@@ -554,6 +1156,7 @@ int LibreArp::getNumInputNotes() const {
 
 void LibreArp::setUserTimeSig(bool v) {
     this->userTimeSig = v;
+    stateChanged();
 }
 
 bool LibreArp::isUserTimeSig() const {
@@ -562,6 +1165,7 @@ bool LibreArp::isUserTimeSig() const {
 
 void LibreArp::setUserTimeSigNumerator(int v) {
     this->userTimeSigNumerator = v;
+    stateChanged();
 }
 
 int LibreArp::getUserTimeSigNumerator() const {
@@ -570,6 +1174,7 @@ int LibreArp::getUserTimeSigNumerator() const {
 
 void LibreArp::setUserTimeSigDenominator(int v) {
     this->userTimeSigDenominator = v;
+    stateChanged();
 }
 
 int LibreArp::getUserTimeSigDenominator() const {
@@ -609,7 +1214,7 @@ void LibreArp::fillCurrentNonPlayingPositionInfo(juce::AudioPlayHead::CurrentPos
     if (cpi.timeSigDenominator) {
         cpi.timeSigDenominator = 4;
     }
-    cpi.isPlaying = !inputNotes.isEmpty();
+    cpi.isPlaying = !inputChord.isEmpty();
 
     // Time data
     auto positionMillis = juce::Time::currentTimeMillis() - silenceEndedTime;
@@ -620,12 +1225,14 @@ void LibreArp::fillCurrentNonPlayingPositionInfo(juce::AudioPlayHead::CurrentPos
 
 
 int LibreArp::getOutputMidiChannel() const {
-    return this->outputMidiChannel;
+    return getLayerParameters(editedLayer).outputMidiChannel;
 }
 
 void LibreArp::setOutputMidiChannel(int channel) {
     jassert(channel >= 1 && channel <= 16);
-    this->outputMidiChannel = channel;
+    auto parameters = getLayerParameters(editedLayer);
+    parameters.outputMidiChannel = channel;
+    setLayerParameters(editedLayer, parameters);
     this->stopAll();
 }
 
@@ -649,8 +1256,9 @@ void LibreArp::setRecordingPatternOffset(bool value) {
 }
 
 void LibreArp::resetPatternOffset() {
-    this->patternOffset = 0;
+    this->patternOffset = 0.0;
     this->stopAll();
+    stateChanged();
 }
 
 
@@ -662,29 +1270,45 @@ void LibreArp::setInputMidiChannel(int channel) {
     jassert(channel >= 0 && channel <= 16);
     this->inputMidiChannel = channel;
     this->stopAll();
-    this->inputNotes.clear();
+    stateChanged();
+    this->inputChord.clear();
 }
 
 float LibreArp::getSwing() const {
-    return *this->swing;
+    return getLayerParameters(editedLayer).swing;
 }
 
 void LibreArp::setSwing(float value) {
-    *this->swing = value;
+    auto parameters = getLayerParameters(editedLayer);
+    parameters.swing = value;
+    setLayerParameters(editedLayer, parameters);
+}
+
+const GrooveTemplate &LibreArp::getGroove() const {
+    return this->groove;
+}
+
+void LibreArp::setGroove(const GrooveTemplate &newGroove) {
+    this->groove = newGroove;
+    for (int i = 0; i < this->numLayers; i++) {
+        buildLayer(*this->layers[i]);
+    }
 }
 
 NonPlayingMode::Value LibreArp::getNonPlayingModeOverride() const {
-    return nonPlayingModeOverride;
+    return nonPlayingModeOverride.load();
 }
 
 void LibreArp::setNonPlayingModeOverride(NonPlayingMode::Value mode) {
     this->nonPlayingModeOverride = mode;
+    stateChanged();
 }
 
 NonPlayingMode::Value LibreArp::getNonPlayingMode() const {
-    return (nonPlayingModeOverride == NonPlayingMode::Value::NONE)
-           ? globals.getNonPlayingMode()
-           : nonPlayingModeOverride;
+    auto mode = nonPlayingModeOverride.load();
+    return (mode == NonPlayingMode::Value::NONE)
+           ? globals.getAudioSnapshot().nonPlayingMode
+           : mode;
 }
 
 int LibreArp::getMaxChordSize() const {
@@ -719,134 +1343,257 @@ Updater::UpdateInfo& LibreArp::getLastUpdateInfo() {
 }
 
 
-void LibreArp::processInputMidi(juce::MidiBuffer &inMidi, bool isPlaying) {
+void LibreArp::processInputMidi(juce::MidiBufferIterator &input,
+                                const juce::MidiBufferIterator &inputEnd,
+                                int toSample,
+                                bool isPlaying,
+                                NonPlayingMode::Value nonPlayingMode) {
     bool inputNotesChanged = false;
-    int sample = 0;
-    juce::MidiBuffer outMidi;
+    bool wasSilent = inputChord.isEmpty();
+
+    for (; input != inputEnd && (*input).samplePosition <= toSample; ++input) {
+        const juce::MidiMessageMetadata metadata = *input;
+        auto sample = metadata.samplePosition;
+
+        if (metadata.numBytes > 3) {
+            // Not a note; passed through without being copied into a MidiMessage, which would allocate for it
+            outputMidi.add(metadata.data, metadata.numBytes, sample);
+            continue;
+        }
 
-    for (const juce::MidiMessageMetadata metadata : inMidi) {
         juce::MidiMessage message = metadata.getMessage();
 
         if (inputMidiChannel == 0 || message.getChannel() == inputMidiChannel) {
             bool processed = false;
             if (message.isNoteOn()) {
-                inputNotes.add(InputNote(message.getNoteNumber(), message.getVelocity() / 127.0));
+                inputChord.add(message.getNoteNumber(), message.getVelocity() / 127.0);
                 processed = true;
                 inputNotesChanged = true;
             } else if (message.isNoteOff()) {
-                inputNotes.removeValue(InputNote(message.getNoteNumber()));
+                inputChord.remove(message.getNoteNumber());
                 processed = true;
                 inputNotesChanged = true;
             }
 
-            if (!processed || *bypass || (!isPlaying && getNonPlayingMode() == NonPlayingMode::Value::PASSTHROUGH)) {
-                outMidi.addEvent(message, sample);
+            if (!processed || *bypass || (!isPlaying && nonPlayingMode == NonPlayingMode::Value::PASSTHROUGH)) {
+                outputMidi.add(message, sample);
             }
-        } else {
+        } else if (outputMidi.add(message, sample)) {
             if (message.isNoteOn()) {
-                setNotePlaying(message.getChannel(), message.getNoteNumber());
+                activeNotes.noteOn(message.getChannel(), message.getNoteNumber());
             } else if (message.isNoteOff()) {
-                setNoteNotPlaying(message.getChannel(), message.getNoteNumber());
+                activeNotes.noteOff(message.getChannel(), message.getNoteNumber());
             }
+        }
+    }
 
-            outMidi.addEvent(message, sample);
+    if (inputNotesChanged) {
+        if (wasSilent && !inputChord.isEmpty()) {
+            silenceEndedTime = juce::Time::currentTimeMillis();
+        }
+        for (auto &layer : layers) {
+            layer->events->outputNotes.invalidate();
+        }
+        if (!inputChord.isEmpty()) {
+            smartOctaveNumber = 1 + (inputChord.getHighest() - inputChord.getLowest()) / NOTES_IN_OCTAVE;
         }
     }
+}
 
-    if (inputNotesChanged && !inputNotes.isEmpty()) {
-        smartOctaveNumber = 1 + (inputNotes.getLast().note - inputNotes.getFirst().note) / NOTES_IN_OCTAVE;
+LibreArp::InputNote LibreArp::getInputNote(int index) const {
+    auto note = inputChord.getNote(index);
+    if (note < 0) {
+        return InputNote();
     }
+    return InputNote(note, inputChord.getVelocity(note));
+}
 
-    inMidi.swapWith(outMidi);
+int LibreArp::getNumFedInputNotes() const {
+    return inputChord.size();
 }
 
+OutputNoteTable::Settings LibreArp::getOutputNoteSettings(const LayerParameters &parameters) const {
+    OutputNoteTable::Settings settings;
+    settings.maxChordSize = maxChordSize->get();
+    settings.fromTop = (extraNotesSelectionMode->getIndex() == FROM_TOP);
+    settings.octaves = parameters.octaves;
+    settings.smartOctaves = parameters.smartOctaves;
+    settings.usingInputVelocity = usingInputVelocity->get();
+    return settings;
+}
 
+OutputNoteTable::Entry LibreArp::mapOutputNote(int noteNumber, const OutputNoteTable::Settings &settings) const {
+    OutputNoteTable::Entry result;
+    auto numInputNotes = getNumFedInputNotes();
 
-void LibreArp::stopAll() {
-    this->stopScheduled = true;
+    // Max chord size processing
+    int chordSize;
+    int indexOffset;
+    if (settings.maxChordSize == 0) {
+        chordSize = numInputNotes;
+        indexOffset = 0;
+    } else {
+        chordSize = settings.maxChordSize;
+        indexOffset = (chordSize < numInputNotes && settings.fromTop)
+            ? numInputNotes - chordSize
+            : 0;
+    }
+
+    auto index = noteNumber % chordSize;
+    if (index < 0)
+        index += numInputNotes;
+    index += indexOffset;
+
+    if (index > numInputNotes) {
+        result.skipped = true;
+        return result;
+    }
+
+    auto inputNote = getInputNote(index);
+    auto note = inputNote.note;
+    result.velocityScale = (settings.usingInputVelocity) ? inputNote.velocity * 1.25 : 1.0;
+
+    // Transposition
+    if (settings.octaves) {
+        auto octNn = (noteNumber >= 0) ? noteNumber : noteNumber + 1;
+        auto octave = octNn / chordSize;
+        if (noteNumber < 0) {
+            octave--;
+        }
+        note += (settings.smartOctaves)
+                ? octave * smartOctaveNumber * NOTES_IN_OCTAVE
+                : octave * NOTES_IN_OCTAVE;
+    }
+
+    if (juce::isPositiveAndBelow(note, 128)) {
+        result.note = note;
+    }
+    return result;
 }
 
-void LibreArp::stopAll(juce::MidiBuffer &midi) {
-    for (int channel = 1; channel <= 16; channel++) {
-        for (int noteNumber = 0; noteNumber <= 127; noteNumber++) {
-            if (isNotePlaying(channel, noteNumber)) {
-                midi.addEvent(juce::MidiMessage::noteOff(channel, noteNumber), 0);
+
+
+void LibreArp::swapPendingEvents(Layer &layer, MidiOutputQueue &midi) {
+    auto newEvents = layer.pendingEvents.exchange(nullptr);
+    if (newEvents == nullptr) {
+        return;
+    }
+
+    // Unchanged notes of an edit keep playing and are stopped by the new events; other notes may have lost their
+    // note-offs, so they are stopped now
+    auto &oldEvents = *layer.events;
+    for (size_t w = 0; w < oldEvents.playingIndices.size(); w++) {
+        auto word = oldEvents.playingIndices[w];
+        while (word != 0) {
+            auto index = static_cast<uint32_t>(w * 64) + static_cast<uint32_t>(BitUtils::countTrailingZeros(word));
+            word &= word - 1;
+
+            auto &lastNote = oldEvents.lastNotes[index];
+            if (newEvents->edited && index < newEvents->lastNotes.size() && !newEvents->isChanged(index)) {
+                newEvents->setLastNote(index, lastNote);
+            } else {
+                midi.add(juce::MidiMessage::noteOff(lastNote.outChannel, lastNote.noteNumber), 0);
+                activeNotes.noteOff(lastNote.outChannel, lastNote.noteNumber);
             }
         }
     }
-    playingNotesBitset.reset();
 
-    for (auto &data : events.data) {
-        data.lastNote = ArpBuiltEvents::PlayingNote(-1, -1);
+    if (newEvents->edited) {
+        layer.scheduler.eventsEdited();
+    } else {
+        layer.scheduler.reset();
     }
+
+    // The replaced events are retired without waiting for the previously retired ones to be deleted, by taking those
+    // along
+    auto retired = layer.events.release();
+    retired->previous.reset(layer.retiredEvents.exchange(nullptr));
+    layer.retiredEvents.store(retired);
+    layer.events.reset(newEvents);
+    updateEditor();
 }
 
-int LibreArp::noteBitsetPosition(int channel, int noteNumber) {
-    return (channel - 1) * 128 + noteNumber;
+void LibreArp::deleteRetiredEvents(Layer &layer) {
+    delete layer.retiredEvents.exchange(nullptr);
 }
 
-bool LibreArp::isNotePlaying(int channel, int noteNumber) {
-    if (noteNumber < 0 || noteNumber > 127 || channel < 1 || channel > 16) {
-        return false;
+void LibreArp::applyRestoredState(MidiOutputQueue &midi) {
+    auto state = pendingState.exchange(nullptr);
+    if (state == nullptr) {
+        return;
     }
 
-    return playingNotesBitset.test((size_t) noteBitsetPosition(channel, noteNumber));
+    stopAll(midi);
+    setRestoredSettings(state->settings);
+    for (size_t i = 0; i < MAX_LAYERS; i++) {
+        auto &layer = *layers[i];
+        std::swap(layer.events, state->events[i]);
+        layer.scheduler.reset();
+        layer.lastSwing = getLayerParameters(static_cast<int>(i)).swing;
+    }
+    this->patternOffset = state->patternOffset;
+
+    // The state now holds the replaced events; it is retired without waiting for the previously retired one to be
+    // deleted, by taking that one along
+    state->previous.reset(retiredState.exchange(nullptr));
+    retiredState.store(state);
+    updateEditor();
 }
 
-void LibreArp::setNotePlaying(int channel, int noteNumber) {
-    if (noteNumber < 0 || noteNumber > 127 || channel < 1 || channel > 16) {
-        return;
-    }
+void LibreArp::deleteRetiredState() {
+    delete retiredState.exchange(nullptr);
+}
 
-    playingNotesBitset.set((size_t) noteBitsetPosition(channel, noteNumber));
+void LibreArp::stopAll() {
+    this->stopScheduled = true;
 }
 
-void LibreArp::setNoteNotPlaying(int channel, int noteNumber) {
-    if (noteNumber < 0 || noteNumber > 127 || channel < 1 || channel > 16) {
-        return;
+void LibreArp::stopAll(MidiOutputQueue &midi) {
+    activeNotes.forEach([&midi](int channel, int noteNumber) {
+        midi.add(juce::MidiMessage::noteOff(channel, noteNumber), 0);
+    });
+    activeNotes.clear();
+    for (auto &layer : layers) {
+        layer->events->clearLastNotes();
     }
-
-    playingNotesBitset.reset((size_t) noteBitsetPosition(channel, noteNumber));
 }
 
 void LibreArp::updateEditor() {
-    auto editor = (MainEditor *) getActiveEditor();
-    if (editor) {
-        editor->triggerAsyncUpdate();
-    }
+    editorUpdatePending.store(true, std::memory_order_release);
 }
 
+void LibreArp::stateChanged() {
+    stateGeneration.fetch_add(1, std::memory_order_release);
+}
 
-int64_t LibreArp::nextTime(ArpBuiltEvents::Event& event, int64_t blockStartPosition, int64_t blockEndPosition) const {
-    int64_t result;
+void LibreArp::parameterValueChanged(int parameterIndex, float newValue) {
+    juce::ignoreUnused(parameterIndex, newValue);
+    stateChanged();
+}
 
-    if (loopReset > 0.0) {
-        auto loopResetLength = static_cast<int64_t>(std::ceil(events.timebase * loopReset));
-        auto resetPosition = blockEndPosition % loopResetLength;
-        auto intermediateResult = resetPosition - (resetPosition % events.loopLength) + event.time;
+void LibreArp::parameterGestureChanged(int parameterIndex, bool gestureIsStarting) {
+    juce::ignoreUnused(parameterIndex, gestureIsStarting);
+}
 
-        result = blockEndPosition - (blockEndPosition % loopResetLength) + intermediateResult;
-    } else {
-        result = blockEndPosition - (blockEndPosition % events.loopLength) + event.time;
-    }
+bool LibreArp::consumeEditorUpdate() {
+    return editorUpdatePending.exchange(false, std::memory_order_acq_rel);
+}
 
-    while (result < blockStartPosition) {
-        result += events.loopLength;
+void LibreArp::deleteRetired() {
+    for (auto &layer : layers) {
+        deleteRetiredEvents(*layer);
     }
 
-    return result;
+    // The last saved state may be written from a pending state the audio thread retires meanwhile
+    std::scoped_lock lock(savedStateMutex);
+    deleteRetiredState();
 }
 
-double LibreArp::applySwing(double position, float swingAmount) const {
-    if (swingAmount == 0.0) {
-        // The resulting modifier would be zero, anyway, so no need to calculate.
-        return position;
-    }
-
-    double swingFreq = (4 * X_PI) / events.timebase;
-    return position - sin(position * swingFreq) * (swingAmount / swingFreq);
+PerformanceStats &LibreArp::getPerformanceStats() {
+    return this->performanceStats;
 }
 
+
 [[maybe_unused]] // Used by JUCE plugin wrappers
 juce::AudioProcessor *JUCE_CALLTYPE createPluginFilter() {
     return new LibreArp();
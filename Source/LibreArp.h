@@ -17,14 +17,25 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <memory>
 #include <sstream>
 #include <mutex>
-#include <bitset>
+#include <vector>
 #include <juce_core/juce_core.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 
+#include "ActiveNoteTracker.h"
 #include "ArpPattern.h"
+#include "EventScheduler.h"
+#include "GrooveTable.h"
+#include "GrooveTemplate.h"
+#include "InputChord.h"
+#include "MidiOutputQueue.h"
+#include "OutputNoteTable.h"
+#include "PerformanceStats.h"
+#include "PulseTimeline.h"
 #include "editor/EditorState.h"
 #include "AudioUpdatable.h"
 #include "Globals.h"
@@ -33,7 +44,7 @@
 /**
  * The LibreArp audio processor.
  */
-class LibreArp : public juce::AudioProcessor {
+class LibreArp : public juce::AudioProcessor, private juce::AudioProcessorParameter::Listener {
 public:
 
     struct InputNote {
@@ -45,7 +56,6 @@ public:
 
     static const juce::Identifier TREEID_LIBREARP;
     static const juce::Identifier TREEID_LOOP_RESET;
-    static const juce::Identifier TREEID_PATTERN_XML;
     static const juce::Identifier TREEID_OCTAVES;
     static const juce::Identifier TREEID_SMART_OCTAVES;
     static const juce::Identifier TREEID_INPUT_VELOCITY;
@@ -58,16 +68,29 @@ public:
     static const juce::Identifier TREEID_NON_PLAYING_MODE_OVERRIDE;
     static const juce::Identifier TREEID_BYPASS;
     static const juce::Identifier TREEID_PATTERN_OFFSET;
+    static const juce::Identifier TREEID_PATTERN_OFFSET_QUARTERS;
     static const juce::Identifier TREEID_USER_TIME_SIG;
     static const juce::Identifier TREEID_USER_TIME_SIG_NUMERATOR;
     static const juce::Identifier TREEID_USER_TIME_SIG_DENOMINATOR;
+    static const juce::Identifier TREEID_LAYERS;
+    static const juce::Identifier TREEID_LAYER;
+    static const juce::Identifier TREEID_EDITED_LAYER;
+
+    /**
+     * The maximum number of pattern layers of a processor.
+     */
+    static constexpr int MAX_LAYERS = 8;
 
     enum ExtraNotesSelectionMode : int {
         FROM_BOTTOM = 0,
         FROM_TOP = 1,
     };
 
-    LibreArp();
+    /**
+     * @param persistentGlobals whether the global settings are loaded from and saved to the user's settings file;
+     *                          offline tools pass `false`
+     */
+    explicit LibreArp(bool persistentGlobals = true);
     ~LibreArp() override;
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
@@ -93,9 +116,15 @@ public:
     /**
      * Serializes this processor into a ValueTree.
      *
+     * @param withPatterns whether the patterns of the layers are included
      * @return the value tree representing this pattern
      */
-    juce::ValueTree toValueTree();
+    juce::ValueTree toValueTree(bool withPatterns = true);
+
+    /**
+     * @return a number incremented every time a saved state is restored
+     */
+    uint64_t getRestoreGeneration() const;
 
     /**
      * Schedules a stop of all currently playing notes. The stop will occur on the next block process.
@@ -103,38 +132,85 @@ public:
     void stopAll();
 
     /**
-     * Sets the pattern to play.
+     * Sets the pattern of the edited layer.
      *
      * @param newPattern the pattern to play
      */
     void setPattern(const ArpPattern &newPattern);
 
     /**
-     * Loads a pattern from the specified file.
+     * Loads a pattern from the specified file into the edited layer. The edited layer is left untouched if the file
+     * cannot be read.
      *
      * @param file the file to load
+     * @return whether the pattern has been loaded
      */
-    void loadPatternFromFile(const juce::File &file);
+    bool loadPatternFromFile(const juce::File &file);
 
     /**
-     * Schedules a pattern build for the processing of the next block.
+     * Builds the pattern of the edited layer and hands the built events over to the audio thread, which picks them up
+     * at the start of the next block. Built events are shared with other instances playing an identical pattern, in
+     * which case no building is necessary. Must not be called from the audio thread.
      */
     void buildPattern();
 
     /**
-     * Gets the current pattern.
+     * Builds the pattern of the edited layer after some of its notes have been changed or appended, patching the
+     * previously built events. Notes of the changed notes that are playing are stopped, the other notes keep playing.
+     * Falls back to `buildPattern()` if the previous events cannot be patched, e.g. when the loop has changed or notes
+     * have been removed. The patched events are not shared with other instances. Must not be called from the audio
+     * thread.
+     *
+     * @param changedNotes the indices of the changed notes; appended notes do not need to be listed
+     */
+    void buildPattern(const std::vector<size_t> &changedNotes);
+
+    /**
+     * Gets the pattern of the edited layer.
      *
-     * @return the current pattern
+     * @return the pattern of the edited layer
      */
     ArpPattern &getPattern();
 
     /**
-     * Gets the last position the processor has played, in pulses.
+     * Gets the last position the processor has played in the edited layer, in pulses.
      *
      * @return the last position the processor has played
      */
     int64_t getLastPosition();
 
+    /**
+     * @return the number of pattern layers
+     */
+    int getNumLayers() const;
+
+    /**
+     * Adds a layer with an empty pattern and the settings of the edited layer, and selects it for editing.
+     *
+     * @return the index of the new layer, or `-1` if there already are `MAX_LAYERS` layers
+     */
+    int addLayer();
+
+    /**
+     * Removes the specified layer. The last remaining layer cannot be removed.
+     *
+     * @param index the index of the layer
+     */
+    void removeLayer(int index);
+
+    /**
+     * @return the index of the layer edited by the pattern editor
+     */
+    int getEditedLayer() const;
+
+    /**
+     * Selects the layer edited by the pattern editor. The pattern, output channel, octave and swing getters and setters
+     * of the processor apply to the edited layer.
+     *
+     * @param index the index of the layer
+     */
+    void setEditedLayer(int index);
+
     /**
      * Sets the amount of beats after which the loop should reset.
      *
@@ -252,6 +328,16 @@ public:
      */
     void setSwing(float value);
 
+    /**
+     * Gets the groove applied by swing.
+     */
+    const GrooveTemplate &getGroove() const;
+
+    /**
+     * Sets the groove applied by swing. Rebuilds the pattern, so it must not be called from the audio thread.
+     */
+    void setGroove(const GrooveTemplate &groove);
+
     NonPlayingMode::Value getNonPlayingModeOverride() const;
 
     void setNonPlayingModeOverride(NonPlayingMode::Value nonPlayingModeOverride);
@@ -265,7 +351,8 @@ public:
     void setExtraNotesSelectionMode(ExtraNotesSelectionMode mode);
 
     /**
-     * Gets the current non-playing mode, taking the global and overridden one into account.
+     * Gets the current non-playing mode, taking the global and overridden one into account. Lock-free, so it is safe
+     * to call from the audio thread.
      */
     NonPlayingMode::Value getNonPlayingMode() const;
 
@@ -275,6 +362,24 @@ public:
 
     Updater::UpdateInfo &getLastUpdateInfo();
 
+    /**
+     * Checks whether the editor has been asked to update since the last call. Polled by the editor.
+     *
+     * @return whether the editor should update
+     */
+    bool consumeEditorUpdate();
+
+    /**
+     * Deletes the events and states the audio thread has replaced. Must not be called from the audio thread; polled
+     * by the editor, so that replaced patterns are freed soon after they stop playing.
+     */
+    void deleteRetired();
+
+    /**
+     * @return the performance statistics of this processor
+     */
+    PerformanceStats &getPerformanceStats();
+
     /**
      * Whether the playhead was playing in the last block.
      */
@@ -305,19 +410,264 @@ private:
     EditorState editorState;
 
     /**
-     * The current pattern.
+     * Built events played by this processor, along with the playback state of their notes.
+     */
+    struct PlayingEvents {
+        explicit PlayingEvents(std::shared_ptr<const ArpBuiltEvents> table,
+                               std::shared_ptr<const GrooveTable> groove = std::make_shared<GrooveTable>());
+
+        /**
+         * Sets the last played MIDI note at the specified index.
+         */
+        void setLastNote(uint32_t index, ArpBuiltEvents::PlayingNote note);
+
+        /**
+         * Marks the note at the specified index as not playing.
+         */
+        void clearLastNote(uint32_t index);
+
+        /**
+         * Marks all notes as not playing. Only visits the indices of notes that are playing.
+         */
+        void clearLastNotes();
+
+        /**
+         * Marks these events as an edit of the previously played ones, with the specified notes changed.
+         */
+        void markEdited(const std::vector<size_t> &changed);
+
+        /**
+         * Merges the edits of the specified events, which have been replaced before being played, into these.
+         */
+        void mergeEdits(const PlayingEvents &replaced);
+
+        /**
+         * @return whether the note at the specified index has been changed by the edit
+         */
+        bool isChanged(uint32_t index) const;
+
+        /**
+         * The built events, possibly shared with other processors.
+         */
+        std::shared_ptr<const ArpBuiltEvents> table;
+
+        /**
+         * The groove, precomputed for the timebase of the built events. Shared by the edits of the same pattern.
+         */
+        std::shared_ptr<const GrooveTable> groove;
+
+        /**
+         * The output notes of the pattern's note numbers with the current chord and settings.
+         */
+        OutputNoteTable outputNotes;
+
+        /**
+         * The last played MIDI notes, indexed the same as the note data of the built events.
+         */
+        std::vector<ArpBuiltEvents::PlayingNote> lastNotes;
+
+        /**
+         * Bitmap of the indices in `lastNotes` that hold a playing note.
+         */
+        std::vector<uint64_t> playingIndices;
+
+        /**
+         * Whether these events are an edit of the previously played ones, in which case playback continues without
+         * stopping the unchanged notes.
+         */
+        bool edited = false;
+
+        /**
+         * Bitmap of the indices of notes changed by the edit.
+         */
+        std::vector<uint64_t> changedIndices;
+
+        /**
+         * The events retired before these, deleted along with them.
+         */
+        std::unique_ptr<PlayingEvents> previous;
+    };
+
+    /**
+     * The settings of a layer that may differ between layers.
+     */
+    struct LayerParameters {
+        int outputMidiChannel = 1;
+        bool octaves = true;
+        bool smartOctaves = true;
+        float swing = 0.0f;
+    };
+
+    /**
+     * A pattern played by the processor, along with its playback state. All layers share the input chord and the
+     * tracking of output notes; their events are generated in a single pass ordered by time.
+     */
+    struct Layer {
+        Layer();
+        ~Layer();
+
+        /**
+         * The pattern of the layer.
+         */
+        ArpPattern pattern;
+
+        /**
+         * The most recently built events. Used on the message thread as the base of incremental builds.
+         */
+        std::shared_ptr<const ArpBuiltEvents> builtEvents;
+
+        /**
+         * The groove precomputed for `builtEvents`. Used on the message thread, reused by incremental builds.
+         */
+        std::shared_ptr<const GrooveTable> grooveTable;
+
+        /**
+         * The pattern, built for playback. Owned by the audio thread.
+         */
+        std::unique_ptr<PlayingEvents> events;
+
+        /**
+         * Freshly built events waiting to be picked up by the audio thread.
+         */
+        std::atomic<PlayingEvents*> pendingEvents = nullptr;
+
+        /**
+         * Events replaced by the audio thread, waiting to be deleted outside of it, each holding the ones retired
+         * before it. Deleting them may free the built events, so it must not happen on the audio thread.
+         */
+        std::atomic<PlayingEvents*> retiredEvents = nullptr;
+
+        /**
+         * The playback cursor into `events`.
+         */
+        EventScheduler scheduler;
+
+        /**
+         * Converts host time to the pattern time of the layer.
+         */
+        PulseTimeline timeline;
+
+        /**
+         * The output MIDI channel, octave transposition and swing of the layer. Unused by the first layer, whose
+         * octave transposition and swing are host parameters.
+         */
+        std::atomic<int> outputMidiChannel = 1;
+        std::atomic<bool> octaves = true;
+        std::atomic<bool> smartOctaves = true;
+        std::atomic<float> swing = 0.0f;
+
+        /**
+         * The swing of the layer in the last processed block.
+         */
+        float lastSwing = 0.0f;
+
+        /**
+         * The last position the layer has played, in pulses.
+         */
+        std::atomic<int64_t> lastPosition = 0;
+
+        /**
+         * The parameters of the layer in the current block.
+         */
+        LayerParameters blockParameters;
+
+        /**
+         * The output note settings of the layer in the current block.
+         */
+        OutputNoteTable::Settings outputNoteSettings;
+
+        /**
+         * The current block in the swung pattern-space of the layer, in fixed-point pulses.
+         */
+        int64_t swungBlockStart = 0;
+        int64_t swungBlockLength = 1;
+
+        /**
+         * The next event of the layer in the current block, if `hasNextEvent` is set.
+         */
+        bool hasNextEvent = false;
+        size_t nextEventIndex = 0;
+        int64_t nextEventTime = 0;
+        int nextEventOffset = 0;
+    };
+
+    /**
+     * The settings read by the audio thread that are not host parameters. Host parameters (the bypass, the octaves and
+     * swing of the first layer, the maximum chord size and the extra notes selection mode) are set through the host,
+     * which may read and change them at any time, so they cannot switch over together with the rest of a state.
+     */
+    struct RestoredSettings {
+        double loopReset = 0.0;
+        int octaveSize = 0;
+        int inputMidiChannel = 0;
+        NonPlayingMode::Value nonPlayingModeOverride = NonPlayingMode::Value::NONE;
+
+        /**
+         * The parameters of every layer slot. Only the output MIDI channel of the first layer is used; its other
+         * parameters are host parameters.
+         */
+        std::array<LayerParameters, MAX_LAYERS> layerParameters;
+    };
+
+    /**
+     * A restored state, prepared outside of the audio thread for it to switch to at the start of a block.
+     */
+    struct RestoredState {
+
+        /**
+         * The events of every layer slot. Slots past the restored layers get empty events, so that the switch leaves
+         * nothing from before the restore, however many layers are played. After the switch, these are the replaced
+         * events.
+         */
+        std::array<std::unique_ptr<PlayingEvents>, MAX_LAYERS> events;
+
+        /**
+         * The restored pattern offset, in quarter notes.
+         */
+        double patternOffset = 0.0;
+
+        /**
+         * The restored settings.
+         */
+        RestoredSettings settings;
+
+        /**
+         * The state retired before this one, deleted along with it.
+         */
+        std::unique_ptr<RestoredState> previous;
+    };
+
+    /**
+     * A restored state waiting to be picked up by the audio thread.
+     */
+    std::atomic<RestoredState*> pendingState = nullptr;
+
+    /**
+     * Restored states switched to by the audio thread, holding the replaced events, waiting to be deleted outside of
+     * it.
+     */
+    std::atomic<RestoredState*> retiredState = nullptr;
+
+    /**
+     * The layers. All `MAX_LAYERS` are allocated up front, so that adding a layer never reallocates anything the audio
+     * thread may be using; only the first `numLayers` are played.
      */
-    ArpPattern pattern;
+    std::array<std::unique_ptr<Layer>, MAX_LAYERS> layers;
 
     /**
-     * The current pattern's XML representation.
+     * The number of played layers.
      */
-    juce::String patternXml;
+    std::atomic<int> numLayers = 1;
 
     /**
-     * The current pattern, built for playback.
+     * Whether the processor is prepared to play, i.e. the host may be processing blocks.
      */
-    ArpBuiltEvents events;
+    std::atomic<bool> prepared = false;
+
+    /**
+     * The index of the layer edited by the pattern editor.
+     */
+    int editedLayer = 0;
 
     /**
      * Whether the plugin is being bypassed.
@@ -355,14 +705,9 @@ private:
     juce::AudioParameterChoice* extraNotesSelectionMode;
 
     /**
-     * The value of `swing` in the last processed block.
-     */
-    float lastSwing = 0.0f;
-
-    /**
-     * The last position the processor has played, in pulses.
+     * The groove applied by swing.
      */
-    std::atomic<int64_t> lastPosition = 0;
+    GrooveTemplate groove;
 
     /**
      * The amount of beats after which the loop should reset.
@@ -375,29 +720,65 @@ private:
     bool stopScheduled = false;
 
     /**
-     * Whether buildPattern was called.
+     * The currently fed input notes.
      */
-    bool buildScheduled = false;
+    InputChord inputChord;
 
     /**
-     * The number of input notes in the last block.
+     * Incremented on every change of the saved state, except for the editor state. Safe to increment from any thread.
      */
-    int lastNumInputNotes = 0;
+    std::atomic<uint64_t> stateGeneration = 1;
 
     /**
-     * The set of currently fed input notes.
+     * Incremented every time a saved state is restored.
      */
-    juce::SortedSet<InputNote> inputNotes;
+    std::atomic<uint64_t> restoreGeneration = 0;
 
     /**
-     * The set of currently playing output notes.
+     * Guards the last saved state.
      */
-    std::bitset<128 * 16> playingNotesBitset;
+    std::mutex savedStateMutex;
+
+    /**
+     * The last saved state, returned by `getStateInformation()` again for as long as nothing has changed.
+     */
+    juce::MemoryBlock savedState;
+
+    /**
+     * The state generation the last saved state was written at.
+     */
+    uint64_t savedStateGeneration = 0;
+
+    /**
+     * The editor state the last saved state was written with. The editor changes its state directly, so it is
+     * compared instead of being tracked.
+     */
+    EditorState savedEditorState;
+
+    /**
+     * The MIDI output of the current block, written into the host's buffer at the end of the block.
+     */
+    MidiOutputQueue outputMidi;
+
+    /**
+     * Performance statistics of the audio thread.
+     */
+    PerformanceStats performanceStats;
+
+    /**
+     * Whether the editor has been asked to update.
+     */
+    std::atomic<bool> editorUpdatePending = false;
+
+    /**
+     * The currently playing output notes.
+     */
+    ActiveNoteTracker activeNotes;
 
     /**
      * The last active number of input notes.
      */
-    int octaveSize = 0;
+    std::atomic<int> octaveSize = 0;
 
     /** Whether time signature is manually set by the user or automatically
      * determined from the host. */
@@ -421,8 +802,8 @@ private:
     int64_t silenceEndedTime;
 
     /** Playback offset - subtracted from the current playback time. Used to
-     * offset the pattern globally in a song. */
-    int64_t patternOffset = 0;
+     * offset the pattern globally in a song. In quarter notes, so that it is shared by layers of any timebase. */
+    std::atomic<double> patternOffset = 0.0;
 
     /** Whether the plugin is going to be recording the playback offset the
      * next time playback starts. */
@@ -433,22 +814,17 @@ private:
      */
     int smartOctaveNumber = 1;
 
-    /**
-     * The MIDI channel output notes are sent to.
-     */
-    int outputMidiChannel = 1;
-
     /**
      * The MIDI channel input notes are read from. Notes from all channels are read if zero.
      */
-    int inputMidiChannel = 0;
+    std::atomic<int> inputMidiChannel = 0;
 
     /**
      * Overridden non-playing mode.
      *
      * @see NonPlayingMode
      */
-    NonPlayingMode::Value nonPlayingModeOverride = NonPlayingMode::Value::NONE;
+    std::atomic<NonPlayingMode::Value> nonPlayingModeOverride = NonPlayingMode::Value::NONE;
 
     /**
      * Main LibreArp processing method.
@@ -456,53 +832,166 @@ private:
     void processMidi(int numSamples, juce::MidiBuffer &midi);
 
     /**
-     * Processes input MIDI messages.
+     * Processes the input MIDI messages of the block up to and including the specified sample offset. Messages that
+     * are passed through are added to `outputMidi` at their own offsets.
      *
-     * @param inMidi the input MIDI messages
+     * @param input the position of the next input message, advanced past the processed ones
+     * @param inputEnd the end of the input messages
+     * @param toSample the sample offset of the last messages to process
+     * @param isPlaying whether the host is playing
+     * @param nonPlayingMode the non-playing mode in effect for the current block
      */
-    void processInputMidi(juce::MidiBuffer &inMidi, bool isPlaying);
+    void processInputMidi(juce::MidiBufferIterator &input,
+                          const juce::MidiBufferIterator &inputEnd,
+                          int toSample,
+                          bool isPlaying,
+                          NonPlayingMode::Value nonPlayingMode);
 
     /**
-     * Sends a noteOff for all currently playing output notes.
+     * Serializes the state of this processor in the binary format.
+     */
+    void writeState(juce::MemoryBlock &destData);
+
+    /**
+     * Loads a state saved by `getStateInformation()` in the binary format, positioned at its start.
+     */
+    void loadBinaryState(juce::InputStream &in);
+
+    /**
+     * Loads a state saved by older versions as an XML string.
+     */
+    void loadXmlState(juce::InputStream &in);
+
+    /**
+     * Loads the state represented by the specified tree, with the patterns of its layers stored separately.
      *
-     * @param midi the midi messages
+     * @param tree the properties of the processor
+     * @param patterns the patterns of the layers, in order
      */
-    void stopAll(juce::MidiBuffer &midi);
+    void loadState(const juce::ValueTree &tree, std::array<ArpPattern, MAX_LAYERS> &patterns);
 
     /**
-     * Calculates the index of the bit representing the specified note.
+     * Gets the input note at the specified index, or a default note if the index is out of range.
      */
-    static int noteBitsetPosition(int channel, int noteNumber);
+    InputNote getInputNote(int index) const;
 
-    bool isNotePlaying(int channel, int noteNumber);
+    /**
+     * @return the number of currently fed input notes
+     */
+    int getNumFedInputNotes() const;
 
-    void setNotePlaying(int channel, int noteNumber);
+    /**
+     * @return the current values of the behaviour parameters affecting output notes of a layer with the specified
+     *         parameters
+     */
+    OutputNoteTable::Settings getOutputNoteSettings(const LayerParameters &parameters) const;
+
+    /**
+     * Calculates the output of the specified pattern note number with the current input chord. There must be at least
+     * one input note.
+     */
+    OutputNoteTable::Entry mapOutputNote(int noteNumber, const OutputNoteTable::Settings &settings) const;
 
-    void setNoteNotPlaying(int channel, int noteNumber);
+    /**
+     * Gets the current parameters of the specified layer.
+     */
+    LayerParameters getLayerParameters(int index) const;
 
     /**
-     * Sends an asynchronous update to the editor.
+     * Sets the parameters of the specified layer.
      */
-    void updateEditor();
+    void setLayerParameters(int index, const LayerParameters &parameters);
+
+    /**
+     * @return the current settings that are restored along with the events
+     */
+    RestoredSettings getRestoredSettings() const;
+
+    /**
+     * Sets the settings that are restored along with the events. Does not mark the state as changed, so that it may be
+     * called from the audio thread.
+     */
+    void setRestoredSettings(const RestoredSettings &settings);
+
+    /**
+     * Builds the pattern of the specified layer and hands the built events over to the audio thread.
+     */
+    void buildLayer(Layer &layer);
+
+    /**
+     * Builds the pattern of the specified layer after some of its notes have been changed or appended.
+     */
+    void buildLayer(Layer &layer, const std::vector<size_t> &changedNotes);
 
     /**
-     * Calculates the next time of the specified event.
+     * Starts a block of the specified layer: positions its scheduler and finds its first event in the block.
      *
-     * @param event the event of which the next time should be calculated
-     * @param blockEndPosition the current processed position
-     * @param blockStartPosition the last processed position
-     * @return the next time of the event
+     * @param layer the layer
+     * @param parameters the parameters of the layer
+     * @param cpi the position info of the block
+     * @param numSamples the number of samples in the block
      */
-    int64_t nextTime(ArpBuiltEvents::Event& event, int64_t blockStartPosition, int64_t blockEndPosition) const;
+    void beginLayerBlock(Layer &layer,
+                         const LayerParameters &parameters,
+                         const juce::AudioPlayHead::CurrentPositionInfo &cpi,
+                         int numSamples);
 
     /**
-     * Calculates a new position value with swing applied.
+     * Finds the next event of the specified layer in the current block.
      */
-    double applySwing(double position, float swingAmount) const;
-};
+    void advanceLayer(Layer &layer, int numSamples);
+
+    /**
+     * Generates the output MIDI messages of the next event of the specified layer, with the current input chord.
+     */
+    void processLayerEvent(Layer &layer);
+
+    /**
+     * Replaces the current events of the specified layer with the pending ones, if there are any. Called by the audio
+     * thread; the replaced events are retired instead of being deleted. Playing notes of the layer are stopped, with
+     * note-offs added to the specified queue, unless the pending events are an edit, in which case notes that are
+     * still valid keep playing.
+     */
+    void swapPendingEvents(Layer &layer, MidiOutputQueue &midi);
+
+    /**
+     * Deletes the events of the specified layer retired by the audio thread, if there are any. Must not be called from
+     * the audio thread.
+     */
+    void deleteRetiredEvents(Layer &layer);
 
-bool operator> (const LibreArp::InputNote &a, const LibreArp::InputNote &b);
-bool operator< (const LibreArp::InputNote &a, const LibreArp::InputNote &b);
-bool operator>=(const LibreArp::InputNote &a, const LibreArp::InputNote &b);
-bool operator<=(const LibreArp::InputNote &a, const LibreArp::InputNote &b);
-bool operator==(const LibreArp::InputNote &a, const LibreArp::InputNote &b);
+    /**
+     * Switches to the pending restored state, if there is one, along with its settings. Called by the audio thread at
+     * the start of a block, or by `loadState()` while the processor is not prepared; all playing notes are stopped,
+     * with note-offs added to the specified queue.
+     */
+    void applyRestoredState(MidiOutputQueue &midi);
+
+    /**
+     * Deletes the restored states retired by the audio thread, if there are any. Must not be called from the audio
+     * thread.
+     */
+    void deleteRetiredState();
+
+    /**
+     * Sends a noteOff for all currently playing output notes.
+     *
+     * @param midi the midi messages
+     */
+    void stopAll(MidiOutputQueue &midi);
+
+    /**
+     * Asks the editor to update. Does not allocate, so it is safe to call from the audio thread.
+     */
+    void updateEditor();
+
+    /**
+     * Marks the saved state as changed, so that it is written anew on the next `getStateInformation()`. Safe to call
+     * from the audio thread.
+     */
+    void stateChanged();
+
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override;
+
+};
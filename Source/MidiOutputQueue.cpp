@@ -0,0 +1,159 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <limits>
+
+#include "MidiOutputQueue.h"
+
+MidiOutputQueue::MidiOutputQueue(size_t newCapacity, size_t longDataCapacity) {
+    reserve(newCapacity, longDataCapacity);
+}
+
+void MidiOutputQueue::reserve(size_t newCapacity, size_t longDataCapacity) {
+    capacity = std::min(newCapacity, (size_t(1) << SEQUENCE_BITS) - RESERVED_NOTE_OFFS);
+    events = std::vector<Event>();
+    events.reserve(capacity + RESERVED_NOTE_OFFS);
+    longData = std::vector<uint8_t>();
+    longData.reserve(longDataCapacity);
+    noteOnSamples.fill(-1);
+    reservedNoteOffs.fill(-1);
+
+    // Each event of a juce::MidiBuffer takes up its message bytes besides a 32-bit sample offset and a 16-bit size
+    staging = juce::MidiBuffer();
+    auto eventBytes = sizeof(int32_t) + sizeof(uint16_t) + SHORT_MESSAGE_SIZE;
+    staging.ensureSize((capacity + RESERVED_NOTE_OFFS) * eventBytes + longDataCapacity);
+}
+
+bool MidiOutputQueue::add(const juce::MidiMessage &message, int sample) {
+    return add(message.getRawData(), message.getRawDataSize(), sample);
+}
+
+bool MidiOutputQueue::add(const void *data, int numBytes, int sample) {
+    if (numBytes <= 0 || numBytes > std::numeric_limits<uint16_t>::max()) {
+        return false;
+    }
+
+    auto bytes = static_cast<const uint8_t *>(data);
+    auto size = static_cast<size_t>(numBytes);
+
+    bool isNoteOn = false;
+    bool isNoteOff = false;
+    size_t noteIndex = 0;
+    if (size == SHORT_MESSAGE_SIZE) {
+        auto type = bytes[0] & 0xF0;
+        isNoteOn = (type == 0x90 && bytes[2] != 0);
+        isNoteOff = (type == 0x80 || (type == 0x90 && bytes[2] == 0));
+        noteIndex = static_cast<size_t>((bytes[0] & 0x0F) * NUM_NOTES + (bytes[1] & 0x7F));
+    }
+
+    if (events.size() >= capacity) {
+        if (!isNoteOff) {
+            return false;
+        }
+
+        // No note can start again past the capacity, so one note-off per note is enough; the latest one is kept
+        auto reserved = reservedNoteOffs[noteIndex];
+        if (reserved >= 0) {
+            auto &event = events[static_cast<size_t>(reserved)];
+            if (sample > event.sample) {
+                event.sample = sample;
+                event.order = (getNoteOffPriority(noteIndex, sample) << SEQUENCE_BITS) | (event.order & SEQUENCE_MASK);
+                std::copy(bytes, bytes + size, event.bytes.begin());
+            }
+            return true;
+        }
+        reservedNoteOffs[noteIndex] = static_cast<int>(events.size());
+    }
+
+    Event event {};
+    event.sample = sample;
+    event.numBytes = static_cast<uint16_t>(size);
+
+    if (size <= SHORT_MESSAGE_SIZE) {
+        std::copy(bytes, bytes + size, event.bytes.begin());
+    } else {
+        if (longData.capacity() - longData.size() < size) {
+            return false;
+        }
+        event.longDataOffset = static_cast<uint32_t>(longData.size());
+        longData.insert(longData.end(), bytes, bytes + size);
+    }
+
+    uint32_t priority = Priority::OTHER;
+    if (isNoteOn) {
+        noteOnSamples[noteIndex] = sample;
+    } else if (isNoteOff) {
+        priority = getNoteOffPriority(noteIndex, sample);
+    }
+
+    event.order = (priority << SEQUENCE_BITS) | static_cast<uint32_t>(events.size());
+    events.push_back(event);
+    return true;
+}
+
+size_t MidiOutputQueue::size() const {
+    return events.size();
+}
+
+bool MidiOutputQueue::isEmpty() const {
+    return events.empty();
+}
+
+void MidiOutputQueue::clear() {
+    for (auto &event : events) {
+        if (event.numBytes == SHORT_MESSAGE_SIZE) {
+            auto noteIndex = static_cast<size_t>((event.bytes[0] & 0x0F) * NUM_NOTES + (event.bytes[1] & 0x7F));
+            auto type = event.bytes[0] & 0xF0;
+            if (type == 0x90) {
+                noteOnSamples[noteIndex] = -1;
+            }
+            if (type == 0x80 || type == 0x90) {
+                reservedNoteOffs[noteIndex] = -1;
+            }
+        }
+    }
+    events.clear();
+    longData.clear();
+}
+
+void MidiOutputQueue::flushTo(juce::MidiBuffer &midi) {
+    // Events are mostly generated in order, in which case there is nothing to sort
+    if (!std::is_sorted(events.begin(), events.end())) {
+        std::sort(events.begin(), events.end());
+    }
+
+    // The events are sorted, so each one is inserted at the end of the staging buffer, whose storage is reserved
+    staging.clear();
+    for (auto &event : events) {
+        staging.addEvent(getData(event), event.numBytes, event.sample);
+    }
+
+    // The host's buffer takes over the storage of the staging one and vice versa, so nothing is copied
+    midi.swapWith(staging);
+    staging.clear();
+
+    clear();
+}
+
+const uint8_t *MidiOutputQueue::getData(const Event &event) const {
+    return (event.numBytes <= SHORT_MESSAGE_SIZE) ? event.bytes.data() : longData.data() + event.longDataOffset;
+}
+
+uint32_t MidiOutputQueue::getNoteOffPriority(size_t noteIndex, int sample) const {
+    return (noteOnSamples[noteIndex] == sample) ? Priority::NOTE_OFF_AFTER_ON : Priority::NOTE_OFF;
+}
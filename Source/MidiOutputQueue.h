@@ -0,0 +1,195 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/**
+ * Stages the MIDI output of a block in fixed-capacity storage, so that it can be sorted once and handed over to the
+ * host's buffer in a single pass.
+ *
+ * Adding events to a juce::MidiBuffer as they are generated moves the ones after the insert position every time an
+ * event lands before others, which makes dense blocks quadratic. Here, events are appended as they are generated and
+ * ordered by their sample offset when flushed, note-offs before other events at the same offset, so that a note ending
+ * where the same note starts again is not cut off. A note-off of a note started at the same offset within the block
+ * stays after its note-on. Events at the same offset and of the same kind keep the order in which they were added.
+ *
+ * All storage is allocated on construction and by `reserve()`. Once the capacity is reached, events other than
+ * note-offs are dropped; note-offs always fit, so a note that has been started can always be stopped. Storage for one
+ * note-off per channel and note is kept in reserve for that, which is enough since no note can start again after the
+ * capacity is reached.
+ */
+class MidiOutputQueue {
+public:
+
+    /**
+     * @param capacity the maximum number of events in a block, besides the note-offs kept in reserve
+     * @param longDataCapacity the maximum total size of events longer than a short MIDI message (e.g. SysEx) in a block
+     */
+    MidiOutputQueue(size_t capacity, size_t longDataCapacity);
+
+    /**
+     * Reallocates the storage of the queue for the specified capacity, dropping all events. Not to be called from the
+     * audio thread.
+     *
+     * @param capacity the maximum number of events in a block, besides the note-offs kept in reserve
+     * @param longDataCapacity the maximum total size of events longer than a short MIDI message (e.g. SysEx) in a block
+     */
+    void reserve(size_t capacity, size_t longDataCapacity);
+
+    /**
+     * Adds a MIDI message.
+     *
+     * @param message the message
+     * @param sample the sample offset of the message within the block
+     * @return whether the message fit in the queue; always true for note-offs
+     */
+    bool add(const juce::MidiMessage &message, int sample);
+
+    /**
+     * Adds a raw MIDI message.
+     *
+     * @param data the bytes of the message
+     * @param numBytes the number of bytes of the message
+     * @param sample the sample offset of the message within the block
+     * @return whether the message fit in the queue; always true for note-offs
+     */
+    bool add(const void *data, int numBytes, int sample);
+
+    /**
+     * @return the number of events in the queue
+     */
+    size_t size() const;
+
+    /**
+     * @return whether the queue has no events
+     */
+    bool isEmpty() const;
+
+    /**
+     * Removes all events.
+     */
+    void clear();
+
+    /**
+     * Replaces the contents of the specified buffer with the events of the queue, in order, and clears the queue. The
+     * buffer may be given different storage.
+     *
+     * @param midi the buffer to write into
+     */
+    void flushTo(juce::MidiBuffer &midi);
+
+private:
+
+    static constexpr int NUM_CHANNELS = 16;
+    static constexpr int NUM_NOTES = 128;
+    static constexpr size_t SHORT_MESSAGE_SIZE = 3;
+
+    /**
+     * The number of note-offs kept in reserve - one per channel and note.
+     */
+    static constexpr size_t RESERVED_NOTE_OFFS = NUM_CHANNELS * NUM_NOTES;
+
+    /**
+     * The ordering classes of events at the same sample offset.
+     */
+    enum Priority : uint32_t {
+        NOTE_OFF = 0,
+        OTHER = 1,
+        NOTE_OFF_AFTER_ON = 2
+    };
+
+    /**
+     * The number of bits of the sort key taken up by the insertion sequence number.
+     */
+    static constexpr uint32_t SEQUENCE_BITS = 30;
+
+    static constexpr uint32_t SEQUENCE_MASK = (uint32_t(1) << SEQUENCE_BITS) - 1;
+
+    struct Event {
+
+        /**
+         * The sample offset within the block.
+         */
+        int sample;
+
+        /**
+         * The order of the event among others at the same offset - the priority followed by the sequence number.
+         */
+        uint32_t order;
+
+        /**
+         * The offset of the message bytes in `longData`, if the message is longer than a short one.
+         */
+        uint32_t longDataOffset;
+
+        /**
+         * The number of bytes of the message.
+         */
+        uint16_t numBytes;
+
+        /**
+         * The bytes of a short message.
+         */
+        std::array<uint8_t, SHORT_MESSAGE_SIZE> bytes;
+
+        bool operator<(const Event &other) const {
+            return (sample != other.sample) ? sample < other.sample : order < other.order;
+        }
+    };
+
+    /**
+     * The staged events, in the order they were added. Never grows past `capacity` and the reserved note-offs.
+     */
+    std::vector<Event> events;
+
+    /**
+     * The maximum number of events, besides the reserved note-offs.
+     */
+    size_t capacity = 0;
+
+    /**
+     * The bytes of messages longer than a short one. Never grows past its initial capacity.
+     */
+    std::vector<uint8_t> longData;
+
+    /**
+     * The sample offsets of the note-ons staged in the current block, per channel and note, or `-1`.
+     */
+    std::array<int, NUM_CHANNELS * NUM_NOTES> noteOnSamples {};
+
+    /**
+     * The indices in `events` of the note-offs staged past `capacity`, per channel and note, or `-1`.
+     */
+    std::array<int, NUM_CHANNELS * NUM_NOTES> reservedNoteOffs {};
+
+    /**
+     * The buffer the sorted events are written into before being swapped with the host's. Reserved for the capacity
+     * of the queue; after a swap, it holds the host's storage, which is only reallocated if the output outgrows it.
+     */
+    juce::MidiBuffer staging;
+
+    const uint8_t *getData(const Event &event) const;
+
+    uint32_t getNoteOffPriority(size_t noteIndex, int sample) const;
+};
@@ -0,0 +1,195 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <tuple>
+
+#include "NoteIntervalIndex.h"
+
+bool NoteIntervalIndex::Entry::operator<(const Entry &other) const {
+    return std::tie(start, noteIndex) < std::tie(other.start, other.noteIndex);
+}
+
+void NoteIntervalIndex::rebuild(const std::vector<ArpNote> &notes) {
+    entries.clear();
+    entries.reserve(notes.size());
+    noteNumberCounts.clear();
+    for (size_t i = 0; i < notes.size(); i++) {
+        entries.push_back(makeEntry(notes[i], i));
+        addNoteNumber(notes[i].data.noteNumber);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    positions.resize(entries.size());
+    updatePositions(0, entries.size());
+    augment();
+    valid = true;
+}
+
+void NoteIntervalIndex::update(const std::vector<ArpNote> &notes, const std::vector<size_t> &changedNotes) {
+    if (!valid || entries.size() > notes.size()) {
+        rebuild(notes);
+        return;
+    }
+
+    auto numIndexed = entries.size();
+    for (auto index : changedNotes) {
+        if (index < numIndexed) {
+            moveEntry(notes[index], index);
+        }
+    }
+
+    if (notes.size() > numIndexed) {
+        for (auto i = numIndexed; i < notes.size(); i++) {
+            entries.push_back(makeEntry(notes[i], i));
+            addNoteNumber(notes[i].data.noteNumber);
+        }
+
+        auto firstAppended = entries.begin() + static_cast<std::ptrdiff_t>(numIndexed);
+        std::sort(firstAppended, entries.end());
+        std::inplace_merge(entries.begin(), firstAppended, entries.end());
+
+        positions.resize(entries.size());
+        updatePositions(0, entries.size());
+        augment();
+    }
+}
+
+void NoteIntervalIndex::invalidate() {
+    valid = false;
+}
+
+bool NoteIntervalIndex::isValid() const {
+    return valid;
+}
+
+size_t NoteIntervalIndex::size() const {
+    return entries.size();
+}
+
+void NoteIntervalIndex::findOverlapping(int64_t from, int64_t to, std::vector<size_t> &result) const {
+    result.clear();
+    findInRange(0, entries.size(), from, to, result);
+    std::sort(result.begin(), result.end());
+}
+
+bool NoteIntervalIndex::getBounds(int64_t &outStart, int64_t &outEnd,
+                                  int &outMinNoteNumber, int &outMaxNoteNumber) const {
+    if (entries.empty()) {
+        return false;
+    }
+
+    outStart = entries.front().start;
+    outEnd = maxEnds[entries.size() / 2];
+    outMinNoteNumber = noteNumberCounts.begin()->first;
+    outMaxNoteNumber = noteNumberCounts.rbegin()->first;
+    return true;
+}
+
+void NoteIntervalIndex::moveEntry(const ArpNote &note, size_t index) {
+    auto from = static_cast<size_t>(positions[index]);
+    auto entry = makeEntry(note, index);
+    removeNoteNumber(entries[from].noteNumber);
+    addNoteNumber(entry.noteNumber);
+
+    // All other entries are sorted, so the new position is found by a binary search on the side the entry moves to
+    auto at = [this](size_t position) { return entries.begin() + static_cast<std::ptrdiff_t>(position); };
+    size_t to;
+    if (entry < entries[from]) {
+        auto it = std::lower_bound(at(0), at(from), entry);
+        to = static_cast<size_t>(it - at(0));
+        std::move_backward(it, at(from), at(from + 1));
+    } else {
+        auto it = std::lower_bound(at(from + 1), entries.end(), entry);
+        to = static_cast<size_t>(it - at(0)) - 1;
+        std::move(at(from + 1), it, at(from));
+    }
+    entries[to] = entry;
+
+    auto lo = std::min(from, to);
+    auto hi = std::max(from, to) + 1;
+    updatePositions(lo, hi);
+    augmentRange(0, entries.size(), lo, hi);
+}
+
+void NoteIntervalIndex::updatePositions(size_t lo, size_t hi) {
+    for (auto i = lo; i < hi; i++) {
+        positions[entries[i].noteIndex] = static_cast<uint32_t>(i);
+    }
+}
+
+void NoteIntervalIndex::augment() {
+    maxEnds.resize(entries.size());
+    augmentRange(0, entries.size(), 0, entries.size());
+}
+
+int64_t NoteIntervalIndex::augmentRange(size_t lo, size_t hi, size_t dirtyLo, size_t dirtyHi) {
+    if (lo >= hi) {
+        return INT64_MIN;
+    }
+
+    auto mid = lo + (hi - lo) / 2;
+    if (hi <= dirtyLo || lo >= dirtyHi) {
+        return maxEnds[mid]; // Nothing in this subtree has changed
+    }
+
+    auto maxEnd = std::max({
+            entries[mid].end,
+            augmentRange(lo, mid, dirtyLo, dirtyHi),
+            augmentRange(mid + 1, hi, dirtyLo, dirtyHi) });
+    maxEnds[mid] = maxEnd;
+    return maxEnd;
+}
+
+void NoteIntervalIndex::addNoteNumber(int noteNumber) {
+    noteNumberCounts[noteNumber]++;
+}
+
+void NoteIntervalIndex::removeNoteNumber(int noteNumber) {
+    auto it = noteNumberCounts.find(noteNumber);
+    if (it != noteNumberCounts.end() && --it->second == 0) {
+        noteNumberCounts.erase(it);
+    }
+}
+
+void NoteIntervalIndex::findInRange(size_t lo, size_t hi, int64_t from, int64_t to,
+                                    std::vector<size_t> &result) const {
+    if (lo >= hi) {
+        return;
+    }
+
+    auto mid = lo + (hi - lo) / 2;
+    if (maxEnds[mid] <= from) {
+        return; // Everything in this subtree ends before the range
+    }
+
+    findInRange(lo, mid, from, to, result);
+
+    auto &entry = entries[mid];
+    if (entry.start >= to) {
+        return; // The rest of this subtree starts after the range
+    }
+
+    if (entry.end > from) {
+        result.push_back(entry.noteIndex);
+    }
+    findInRange(mid + 1, hi, from, to, result);
+}
+
+NoteIntervalIndex::Entry NoteIntervalIndex::makeEntry(const ArpNote &note, size_t index) {
+    return { note.startPoint, note.endPoint, static_cast<uint32_t>(index), note.data.noteNumber };
+}
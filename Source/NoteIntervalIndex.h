@@ -0,0 +1,147 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "ArpNote.h"
+
+/**
+ * An index of the notes of a pattern by time, answering which notes overlap a range of pulses in logarithmic time.
+ *
+ * The notes are kept in an array sorted by their start, viewed as an implicit balanced binary tree: the middle entry of
+ * each range is the root of the subtree of that range, and is augmented with the maximum end of all notes in the
+ * range. Subtrees ending before the queried range, or starting after it, are skipped entirely.
+ */
+class NoteIntervalIndex {
+public:
+
+    /**
+     * Rebuilds the index from the specified notes.
+     */
+    void rebuild(const std::vector<ArpNote> &notes);
+
+    /**
+     * Updates the index after some of the notes have been changed or appended. Each changed note is moved to its new
+     * position, shifting the entries it moves across, and only the part of the tree covering those is re-augmented.
+     * Appended notes change the shape of the whole tree, so they are merged in and the tree is re-augmented in linear
+     * time. Notes must not have been removed since the last update.
+     *
+     * @param notes all notes
+     * @param changedNotes the indices of the changed notes; appended notes do not need to be listed
+     */
+    void update(const std::vector<ArpNote> &notes, const std::vector<size_t> &changedNotes);
+
+    /**
+     * Marks the index as out of date, e.g. after notes have been removed.
+     */
+    void invalidate();
+
+    /**
+     * @return whether the index is up to date
+     */
+    bool isValid() const;
+
+    /**
+     * @return the number of indexed notes
+     */
+    size_t size() const;
+
+    /**
+     * Finds the notes overlapping the specified range, i.e. starting before its end and ending after its start.
+     *
+     * @param from the start of the range, in pulses
+     * @param to the end of the range, in pulses
+     * @param result the vector the indices of the found notes are written into, in ascending order
+     */
+    void findOverlapping(int64_t from, int64_t to, std::vector<size_t> &result) const;
+
+    /**
+     * Gets the extent of all indexed notes.
+     *
+     * @return `false` if there are no notes, in which case the output variables are left untouched
+     */
+    bool getBounds(int64_t &outStart, int64_t &outEnd, int &outMinNoteNumber, int &outMaxNoteNumber) const;
+
+private:
+
+    struct Entry {
+        int64_t start;
+        int64_t end;
+        uint32_t noteIndex;
+        int noteNumber;
+
+        bool operator<(const Entry &other) const;
+    };
+
+    /**
+     * The notes, sorted by start.
+     */
+    std::vector<Entry> entries;
+
+    /**
+     * The maximum end of the notes in each subtree, stored at the position of its root.
+     */
+    std::vector<int64_t> maxEnds;
+
+    /**
+     * The position of each note in `entries`, indexed by note index.
+     */
+    std::vector<uint32_t> positions;
+
+    /**
+     * The number of notes with each note number.
+     */
+    std::map<int, size_t> noteNumberCounts;
+
+    bool valid = false;
+
+    /**
+     * Moves the entry of the specified note to the position of its new start, and re-augments the part of the tree
+     * covering the entries it has moved across.
+     */
+    void moveEntry(const ArpNote &note, size_t index);
+
+    /**
+     * Updates `positions` of the entries in the specified range of positions.
+     */
+    void updatePositions(size_t lo, size_t hi);
+
+    /**
+     * Recalculates `maxEnds` of the whole tree.
+     */
+    void augment();
+
+    /**
+     * Recalculates `maxEnds` of the subtree of the range [lo, hi) that covers any of the range [dirtyLo, dirtyHi),
+     * keeping the rest.
+     *
+     * @return the maximum end of the notes in the range
+     */
+    int64_t augmentRange(size_t lo, size_t hi, size_t dirtyLo, size_t dirtyHi);
+
+    void addNoteNumber(int noteNumber);
+
+    void removeNoteNumber(int noteNumber);
+
+    void findInRange(size_t lo, size_t hi, int64_t from, int64_t to, std::vector<size_t> &result) const;
+
+    static Entry makeEntry(const ArpNote &note, size_t index);
+};
@@ -0,0 +1,50 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+
+#include "OutputNoteTable.h"
+
+bool OutputNoteTable::Settings::operator==(const Settings &other) const {
+    return maxChordSize == other.maxChordSize
+        && fromTop == other.fromTop
+        && octaves == other.octaves
+        && smartOctaves == other.smartOctaves
+        && usingInputVelocity == other.usingInputVelocity;
+}
+
+bool OutputNoteTable::Settings::operator!=(const Settings &other) const {
+    return !(*this == other);
+}
+
+OutputNoteTable::OutputNoteTable(const std::vector<int> &noteNumbers) {
+    if (noteNumbers.empty()) {
+        return;
+    }
+
+    auto minMax = std::minmax_element(noteNumbers.begin(), noteNumbers.end());
+    this->minNoteNumber = *minMax.first;
+    this->entries.resize(static_cast<size_t>(*minMax.second - *minMax.first) + 1);
+}
+
+bool OutputNoteTable::isUpToDate(const Settings &settings) const {
+    return this->valid && this->settings == settings;
+}
+
+void OutputNoteTable::invalidate() {
+    this->valid = false;
+}
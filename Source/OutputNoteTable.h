@@ -0,0 +1,122 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * A lookup table from the note numbers of a pattern to the MIDI notes they play with the current input chord and
+ * behaviour settings, so that generating a note costs only an array read.
+ *
+ * The table covers the range of note numbers used by a pattern. It is allocated along with the built events on the
+ * message thread, and refilled on the audio thread whenever the chord or the settings change.
+ */
+class OutputNoteTable {
+public:
+
+    /**
+     * The output of a single pattern note number.
+     */
+    struct Entry {
+
+        /**
+         * The MIDI note to play, or `-1` if nothing is played.
+         */
+        int note = -1;
+
+        /**
+         * Whether the note maps past the input notes, in which case its last played note is forgotten.
+         */
+        bool skipped = false;
+
+        /**
+         * The multiplier of the velocity of the pattern note.
+         */
+        double velocityScale = 1.0;
+    };
+
+    /**
+     * The behaviour settings the table has been filled for.
+     */
+    struct Settings {
+        int maxChordSize = 0;
+        bool fromTop = false;
+        bool octaves = false;
+        bool smartOctaves = false;
+        bool usingInputVelocity = false;
+
+        bool operator==(const Settings &other) const;
+        bool operator!=(const Settings &other) const;
+    };
+
+    /**
+     * Constructs an empty table.
+     */
+    OutputNoteTable() = default;
+
+    /**
+     * Constructs a table covering the specified note numbers.
+     *
+     * @param noteNumbers the note numbers of a pattern
+     */
+    explicit OutputNoteTable(const std::vector<int> &noteNumbers);
+
+    /**
+     * Gets the entry of the specified note number, which must be one of the note numbers the table was constructed
+     * with.
+     */
+    const Entry &get(int noteNumber) const {
+        return entries[static_cast<size_t>(noteNumber - minNoteNumber)];
+    }
+
+    /**
+     * Checks whether the table has been filled for the specified settings and has not been invalidated since.
+     */
+    bool isUpToDate(const Settings &settings) const;
+
+    /**
+     * Marks the table as out of date, e.g. after the input chord has changed.
+     */
+    void invalidate();
+
+    /**
+     * Refills the table. Does not allocate.
+     *
+     * @param settings the settings the table is filled for
+     * @param mapNote a function returning the `Entry` of a pattern note number
+     */
+    template<typename F>
+    void fill(const Settings &settings, F mapNote) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            entries[i] = mapNote(minNoteNumber + static_cast<int>(i));
+        }
+        this->settings = settings;
+        this->valid = true;
+    }
+
+private:
+
+    int minNoteNumber = 0;
+
+    std::vector<Entry> entries;
+
+    Settings settings;
+
+    bool valid = false;
+};
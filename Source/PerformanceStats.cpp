@@ -0,0 +1,100 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "PerformanceStats.h"
+
+double PerformanceStats::Snapshot::getMeanNanos() const {
+    return (numBlocks > 0)
+        ? static_cast<double>(totalNanos) / static_cast<double>(numBlocks)
+        : 0.0;
+}
+
+void PerformanceStats::record(uint64_t nanos,
+                              double realtimeNanos,
+                              uint32_t emittedEvents,
+                              uint32_t scannedEvents) {
+    if (resetRequested.exchange(false, std::memory_order_acquire)) {
+        numBlocks.store(0, std::memory_order_relaxed);
+        numOverBudgetBlocks.store(0, std::memory_order_relaxed);
+        numEmittedEvents.store(0, std::memory_order_relaxed);
+        numScannedEvents.store(0, std::memory_order_relaxed);
+        totalNanos.store(0, std::memory_order_relaxed);
+        maxNanos.store(0, std::memory_order_relaxed);
+        for (auto &bucket : histogram) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    add(numBlocks, 1);
+    add(numEmittedEvents, emittedEvents);
+    add(numScannedEvents, scannedEvents);
+    add(totalNanos, nanos);
+    add(histogram[static_cast<size_t>(getBucketIndex(nanos))], 1);
+    lastNanos.store(nanos, std::memory_order_relaxed);
+
+    if (nanos > maxNanos.load(std::memory_order_relaxed)) {
+        maxNanos.store(nanos, std::memory_order_relaxed);
+    }
+    if (static_cast<double>(nanos) > realtimeNanos * budget.load(std::memory_order_relaxed)) {
+        add(numOverBudgetBlocks, 1);
+    }
+}
+
+PerformanceStats::Snapshot PerformanceStats::getSnapshot() const {
+    Snapshot result;
+    result.numBlocks = numBlocks.load(std::memory_order_relaxed);
+    result.numOverBudgetBlocks = numOverBudgetBlocks.load(std::memory_order_relaxed);
+    result.numEmittedEvents = numEmittedEvents.load(std::memory_order_relaxed);
+    result.numScannedEvents = numScannedEvents.load(std::memory_order_relaxed);
+    result.totalNanos = totalNanos.load(std::memory_order_relaxed);
+    result.maxNanos = maxNanos.load(std::memory_order_relaxed);
+    result.lastNanos = lastNanos.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < histogram.size(); i++) {
+        result.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void PerformanceStats::reset() {
+    resetRequested.store(true, std::memory_order_release);
+}
+
+double PerformanceStats::getBudget() const {
+    return budget;
+}
+
+void PerformanceStats::setBudget(double value) {
+    budget = value;
+}
+
+int PerformanceStats::getBucketIndex(uint64_t nanos) {
+    auto micros = nanos / 1000;
+    int index = 0;
+    while (micros > 0 && index < NUM_BUCKETS - 1) {
+        micros >>= 1;
+        index++;
+    }
+    return index;
+}
+
+uint64_t PerformanceStats::getBucketLowerBoundMicros(int index) {
+    return (index > 0) ? (uint64_t(1) << (index - 1)) : 0;
+}
+
+void PerformanceStats::add(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
@@ -0,0 +1,124 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free performance statistics of a processor. Written by the audio thread only, once per block; read by the
+ * editor.
+ */
+class PerformanceStats {
+public:
+
+    /**
+     * The number of buckets of the block time histogram. The first bucket holds blocks taking under a microsecond,
+     * each following one blocks taking up to twice as long as the previous one; the last bucket is open-ended.
+     */
+    static constexpr int NUM_BUCKETS = 16;
+
+    /**
+     * The default budget, relative to the realtime duration of a block.
+     */
+    static constexpr double DEFAULT_BUDGET = 0.1;
+
+    /**
+     * A copy of the statistics at one point in time.
+     */
+    struct Snapshot {
+        uint64_t numBlocks = 0;
+        uint64_t numOverBudgetBlocks = 0;
+        uint64_t numEmittedEvents = 0;
+        uint64_t numScannedEvents = 0;
+        uint64_t totalNanos = 0;
+        uint64_t maxNanos = 0;
+        uint64_t lastNanos = 0;
+        std::array<uint64_t, NUM_BUCKETS> histogram {};
+
+        /**
+         * @return the mean processing time of a block, in nanoseconds
+         */
+        double getMeanNanos() const;
+    };
+
+    /**
+     * Records a processed block. Only to be called by the audio thread.
+     *
+     * @param nanos the time taken to process the block, in nanoseconds
+     * @param realtimeNanos the realtime duration of the block, in nanoseconds
+     * @param numEmittedEvents the number of MIDI events sent to the host
+     * @param numScannedEvents the number of pattern events visited by the scheduler
+     */
+    void record(uint64_t nanos, double realtimeNanos, uint32_t numEmittedEvents, uint32_t numScannedEvents);
+
+    /**
+     * @return a copy of the current statistics
+     */
+    Snapshot getSnapshot() const;
+
+    /**
+     * Clears the statistics. The reset is carried out by the audio thread, with the next recorded block.
+     */
+    void reset();
+
+    /**
+     * @return the budget, relative to the realtime duration of a block
+     */
+    double getBudget() const;
+
+    /**
+     * Sets the budget. Blocks taking longer than this fraction of their realtime duration are counted as over budget.
+     *
+     * @param budget the budget, relative to the realtime duration of a block
+     */
+    void setBudget(double budget);
+
+    /**
+     * Gets the index of the histogram bucket for the specified processing time.
+     *
+     * @param nanos the processing time, in nanoseconds
+     * @return the index of the bucket
+     */
+    static int getBucketIndex(uint64_t nanos);
+
+    /**
+     * @return the lowest processing time of the specified histogram bucket, in microseconds
+     */
+    static uint64_t getBucketLowerBoundMicros(int index);
+
+private:
+
+    std::atomic<uint64_t> numBlocks = 0;
+    std::atomic<uint64_t> numOverBudgetBlocks = 0;
+    std::atomic<uint64_t> numEmittedEvents = 0;
+    std::atomic<uint64_t> numScannedEvents = 0;
+    std::atomic<uint64_t> totalNanos = 0;
+    std::atomic<uint64_t> maxNanos = 0;
+    std::atomic<uint64_t> lastNanos = 0;
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> histogram {};
+
+    std::atomic<double> budget = DEFAULT_BUDGET;
+    std::atomic<bool> resetRequested = false;
+
+    /**
+     * Increments a counter only ever written by the audio thread, avoiding a read-modify-write operation.
+     */
+    static void add(std::atomic<uint64_t> &counter, uint64_t value);
+};
@@ -0,0 +1,280 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "ArpPattern.h"
+#include "PresetLibrary.h"
+#include "util/Defer.h"
+
+static const char INDEX_MAGIC[4] = { 'L', 'A', 'P', 'I' };
+static const int INDEX_VERSION = 1;
+
+static const char *const PRESET_WILDCARD = "*.lapreset";
+static const int STOP_TIMEOUT_MS = 4000;
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+
+PresetLibrary::PresetLibrary() : juce::Thread("LibreArp preset library"), entries(std::make_shared<const Entries>()) {
+    startThread();
+}
+
+PresetLibrary::~PresetLibrary() {
+    stopThread(STOP_TIMEOUT_MS);
+}
+
+
+void PresetLibrary::setLocation(const juce::File &newPresetsDir, const juce::File &newIndexFile) {
+    {
+        std::scoped_lock lock(mutex);
+        if (this->presetsDir == newPresetsDir && this->indexFile == newIndexFile) {
+            return;
+        }
+        this->presetsDir = newPresetsDir;
+        this->indexFile = newIndexFile;
+        this->locationGeneration++;
+    }
+    refresh();
+}
+
+void PresetLibrary::refresh() {
+    notify();
+}
+
+juce::File PresetLibrary::getPresetsDir() {
+    std::scoped_lock lock(mutex);
+    return this->presetsDir;
+}
+
+std::shared_ptr<const PresetLibrary::Entries> PresetLibrary::getEntries() {
+    std::scoped_lock lock(mutex);
+    return this->entries;
+}
+
+uint64_t PresetLibrary::getGeneration() const {
+    return this->generation.load();
+}
+
+bool PresetLibrary::isScanning() const {
+    return this->scanning.load();
+}
+
+
+void PresetLibrary::run() {
+    while (!threadShouldExit()) {
+        wait(-1);
+        if (threadShouldExit()) {
+            return;
+        }
+        scan();
+    }
+}
+
+void PresetLibrary::scan() {
+    juce::File dir;
+    juce::File index;
+    uint64_t location;
+    std::shared_ptr<const Entries> previous;
+    {
+        std::scoped_lock lock(mutex);
+        dir = this->presetsDir;
+        index = this->indexFile;
+        location = this->locationGeneration;
+        previous = this->entries;
+    }
+
+    if (!dir.isDirectory()) {
+        return;
+    }
+
+    this->scanning = true;
+    defer d([this] { this->scanning = false; });
+
+    if (this->loadedLocationGeneration != location) {
+        // Show the cached index right away, before the directory is scanned
+        previous = std::make_shared<const Entries>(loadIndex(index));
+        if (!publish(previous, location)) {
+            return;
+        }
+        this->loadedLocationGeneration = location;
+    }
+
+    std::map<juce::String, const Entry *> previousByPath;
+    for (auto &entry : *previous) {
+        previousByPath[entry.path] = &entry;
+    }
+
+    Entries result;
+    result.reserve(previous->size());
+    bool changed = false;
+    for (auto &item : juce::RangedDirectoryIterator(dir, true, PRESET_WILDCARD, juce::File::findFiles)) {
+        if (threadShouldExit()) {
+            return;
+        }
+
+        auto file = item.getFile();
+        auto path = file.getRelativePathFrom(dir).replaceCharacter('\\', '/');
+        auto modificationTime = item.getModificationTime().toMilliseconds();
+        auto size = item.getFileSize();
+
+        auto found = previousByPath.find(path);
+        auto previousEntry = (found != previousByPath.end()) ? found->second : nullptr;
+        if (previousEntry != nullptr
+                && previousEntry->modificationTime == modificationTime
+                && previousEntry->size == size) {
+            result.push_back(*previousEntry);
+            continue;
+        }
+
+        Entry entry;
+        entry.path = path;
+        entry.name = path.upToLastOccurrenceOf(".", false, false);
+        entry.modificationTime = modificationTime;
+        entry.size = size;
+        if (readEntry(file, entry, previousEntry)) {
+            result.push_back(entry);
+        }
+        changed = true;
+    }
+
+    if (!changed && result.size() == previous->size()) {
+        return;
+    }
+
+    std::sort(result.begin(), result.end(), [](const Entry &a, const Entry &b) {
+        return a.name.compareNatural(b.name) < 0;
+    });
+
+    auto newEntries = std::make_shared<const Entries>(std::move(result));
+    if (publish(newEntries, location)) {
+        saveIndex(index, *newEntries);
+    }
+}
+
+bool PresetLibrary::publish(std::shared_ptr<const Entries> newEntries, uint64_t forLocationGeneration) {
+    std::scoped_lock lock(mutex);
+    if (this->locationGeneration != forLocationGeneration) {
+        return false; // Another scan is pending for the new location
+    }
+    this->entries = std::move(newEntries);
+    this->generation++;
+    return true;
+}
+
+
+bool PresetLibrary::readEntry(const juce::File &file, Entry &entry, const Entry *previous) {
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data)) {
+        return false;
+    }
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    auto bytes = static_cast<const uint8_t *>(data.getData());
+    for (size_t i = 0; i < data.getSize(); i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    entry.contentHash = hash;
+
+    if (previous != nullptr && previous->contentHash == hash) {
+        // Only touched, not changed
+        entry.numNotes = previous->numNotes;
+        entry.timebase = previous->timebase;
+        entry.loopLength = previous->loopLength;
+        return true;
+    }
+
+    juce::MemoryInputStream in(data, false);
+    bool success;
+    auto pattern = ArpPattern::fromXmlStream(in, &success);
+    if (!success) {
+        return false; // Malformed files are not listed, so that they cannot be auditioned
+    }
+
+    entry.numNotes = static_cast<int>(pattern.getNotes().size());
+    entry.timebase = pattern.getTimebase();
+    entry.loopLength = pattern.loopLength();
+    return true;
+}
+
+PresetLibrary::Entries PresetLibrary::loadIndex(const juce::File &file) {
+    juce::FileInputStream in(file);
+    if (!in.openedOk()) {
+        return {};
+    }
+
+    char magic[sizeof(INDEX_MAGIC)];
+    if (in.read(magic, sizeof(magic)) != static_cast<int>(sizeof(magic))
+            || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0
+            || in.readInt() != INDEX_VERSION) {
+        return {};
+    }
+
+    auto numEntries = in.readInt();
+    Entries result;
+    for (int i = 0; i < numEntries; i++) {
+        if (in.isExhausted()) {
+            return {}; // Truncated
+        }
+
+        Entry entry;
+        entry.path = in.readString();
+        entry.name = in.readString();
+        entry.numNotes = in.readInt();
+        entry.timebase = in.readInt();
+        entry.loopLength = in.readInt64();
+        entry.modificationTime = in.readInt64();
+        entry.size = in.readInt64();
+        entry.contentHash = static_cast<uint64_t>(in.readInt64());
+        result.push_back(entry);
+    }
+    return result;
+}
+
+void PresetLibrary::saveIndex(const juce::File &file, const Entries &indexEntries) {
+    juce::TemporaryFile tempFile(file);
+    {
+        juce::FileOutputStream out(tempFile.getFile());
+        if (!out.openedOk()) {
+            return;
+        }
+
+        out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        out.writeInt(INDEX_VERSION);
+        out.writeInt(static_cast<int>(indexEntries.size()));
+        for (auto &entry : indexEntries) {
+            out.writeString(entry.path);
+            out.writeString(entry.name);
+            out.writeInt(entry.numNotes);
+            out.writeInt(entry.timebase);
+            out.writeInt64(entry.loopLength);
+            out.writeInt64(entry.modificationTime);
+            out.writeInt64(entry.size);
+            out.writeInt64(static_cast<juce::int64>(entry.contentHash));
+        }
+
+        out.flush();
+        if (out.getStatus().failed()) {
+            return;
+        }
+    }
+    tempFile.overwriteTargetFileWithTemporary();
+}
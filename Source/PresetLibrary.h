@@ -0,0 +1,151 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+/**
+ * An index of the pattern presets in a directory, so that they can be browsed and searched without opening every
+ * file. Shared by all plugin instances through juce::SharedResourcePointer.
+ *
+ * The directory is scanned on a worker thread. The index is cached in a file, so that it is available right away
+ * after it is loaded, and refreshed incrementally: only presets whose modification time or size have changed are
+ * read again, and those whose content has not actually changed are not parsed again.
+ */
+class PresetLibrary : private juce::Thread {
+public:
+
+    /**
+     * The summary of a single preset.
+     */
+    struct Entry {
+        /**
+         * The path of the preset file, relative to the presets directory.
+         */
+        juce::String path;
+
+        /**
+         * The name of the preset - its path without the extension.
+         */
+        juce::String name;
+
+        int numNotes = 0;
+        int timebase = 0;
+        int64_t loopLength = 0;
+
+        /**
+         * The modification time of the file, in milliseconds since the epoch.
+         */
+        int64_t modificationTime = 0;
+        int64_t size = 0;
+
+        /**
+         * The FNV-1a hash of the file contents.
+         */
+        uint64_t contentHash = 0;
+    };
+
+    using Entries = std::vector<Entry>;
+
+
+    PresetLibrary();
+    ~PresetLibrary() override;
+
+    /**
+     * Sets the presets directory and the file the index is cached in, and refreshes the index if they have changed.
+     *
+     * @param presetsDir the directory to index (searched recursively)
+     * @param indexFile the file the index is cached in
+     */
+    void setLocation(const juce::File &presetsDir, const juce::File &indexFile);
+
+    /**
+     * Requests the index to be refreshed on the worker thread.
+     */
+    void refresh();
+
+    /**
+     * @return the presets directory
+     */
+    juce::File getPresetsDir();
+
+    /**
+     * Gets the current index. The returned entries are never modified; a refresh replaces them as a whole.
+     *
+     * @return the entries of the index, sorted by name
+     */
+    std::shared_ptr<const Entries> getEntries();
+
+    /**
+     * @return a number incremented every time the entries are replaced
+     */
+    uint64_t getGeneration() const;
+
+    /**
+     * @return whether the worker thread is currently scanning the directory
+     */
+    bool isScanning() const;
+
+private:
+
+    std::mutex mutex;
+    juce::File presetsDir;
+    juce::File indexFile;
+    uint64_t locationGeneration = 0;
+    std::shared_ptr<const Entries> entries;
+
+    std::atomic<uint64_t> generation = 0;
+    std::atomic<bool> scanning = false;
+
+    /**
+     * The location generation the entries have been loaded for, on the worker thread.
+     */
+    uint64_t loadedLocationGeneration = 0;
+
+    void run() override;
+
+    /**
+     * Scans the presets directory and publishes the updated entries.
+     */
+    void scan();
+
+    /**
+     * Publishes the specified entries, unless the location has changed since `forLocationGeneration`.
+     *
+     * @return whether the entries have been published
+     */
+    bool publish(std::shared_ptr<const Entries> newEntries, uint64_t forLocationGeneration);
+
+    /**
+     * Reads the summary of a preset file into the specified entry, reusing the summary of `previous` if the contents
+     * of the file have not changed.
+     *
+     * @return whether the file has been read successfully and is a well-formed pattern
+     */
+    static bool readEntry(const juce::File &file, Entry &entry, const Entry *previous);
+
+    static Entries loadIndex(const juce::File &file);
+
+    static void saveIndex(const juce::File &file, const Entries &indexEntries);
+};
@@ -0,0 +1,69 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "PulseTimeline.h"
+
+void PulseTimeline::update(double newSampleRate, double newBpm, int newTimebase) {
+    if (newSampleRate == sampleRate && newBpm == bpm && newTimebase == timebase) {
+        return;
+    }
+
+    sampleRate = newSampleRate;
+    bpm = newBpm;
+    timebase = newTimebase;
+    pulsesPerSample = (sampleRate > 0.0)
+            ? fromDouble(bpm * timebase / (60.0 * sampleRate))
+            : 0;
+}
+
+int64_t PulseTimeline::ppqToPosition(double ppqPosition) const {
+    return fromDouble(ppqPosition * timebase);
+}
+
+int64_t PulseTimeline::samplesToDuration(int numSamples) const {
+    return pulsesPerSample * numSamples;
+}
+
+int64_t PulseTimeline::fromPulses(int64_t pulses) {
+    return pulses * ONE_PULSE;
+}
+
+int64_t PulseTimeline::fromDouble(double pulses) {
+    return std::llround(pulses * static_cast<double>(ONE_PULSE));
+}
+
+double PulseTimeline::toDouble(int64_t position) {
+    return static_cast<double>(position) / static_cast<double>(ONE_PULSE);
+}
+
+int64_t PulseTimeline::floorToPulses(int64_t position) {
+    // Arithmetic shift rounds towards negative infinity
+    return position >> FRACTION_BITS;
+}
+
+int64_t PulseTimeline::ceilToPulses(int64_t position) {
+    return (position + ONE_PULSE - 1) >> FRACTION_BITS;
+}
+
+int PulseTimeline::sampleOffset(int64_t time, int64_t blockStart, int64_t blockLength, int numSamples) {
+    auto delta = std::max(int64_t(0), fromPulses(time) - blockStart);
+    auto offset = delta * numSamples / blockLength;
+    return static_cast<int>(std::min(offset, static_cast<int64_t>(numSamples - 1)));
+}
@@ -0,0 +1,114 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Converts between host time and pattern time using fixed-point arithmetic.
+ *
+ * Positions and durations are expressed in fixed-point pulses with `FRACTION_BITS` fractional bits. The rate of
+ * pulses per sample is only recomputed when the sample rate, tempo or timebase change, so advancing by a block and
+ * placing events inside of it is integer-only. Since every block is anchored at the position reported by the host,
+ * no error accumulates between blocks.
+ */
+class PulseTimeline {
+public:
+
+    /**
+     * The number of fractional bits of fixed-point positions.
+     */
+    static constexpr int FRACTION_BITS = 24;
+
+    /**
+     * One pulse in fixed-point.
+     */
+    static constexpr int64_t ONE_PULSE = int64_t(1) << FRACTION_BITS;
+
+    /**
+     * Updates the conversion constants. Does nothing if none of the parameters have changed.
+     *
+     * @param sampleRate the sample rate in Hz
+     * @param bpm the tempo in beats per minute
+     * @param timebase the timebase in PPQ
+     */
+    void update(double sampleRate, double bpm, int timebase);
+
+    /**
+     * Converts a host position to a fixed-point position.
+     *
+     * @param ppqPosition the position in quarter notes
+     * @return the position in fixed-point pulses
+     */
+    int64_t ppqToPosition(double ppqPosition) const;
+
+    /**
+     * Converts a number of samples to a fixed-point duration.
+     *
+     * @param numSamples the number of samples
+     * @return the duration in fixed-point pulses
+     */
+    int64_t samplesToDuration(int numSamples) const;
+
+    /**
+     * Converts whole pulses to fixed-point.
+     */
+    static int64_t fromPulses(int64_t pulses);
+
+    /**
+     * Converts a fractional number of pulses to fixed-point, rounding to the nearest representable value.
+     */
+    static int64_t fromDouble(double pulses);
+
+    /**
+     * Converts a fixed-point value to a fractional number of pulses.
+     */
+    static double toDouble(int64_t position);
+
+    /**
+     * @return the last whole pulse at or before the specified fixed-point position
+     */
+    static int64_t floorToPulses(int64_t position);
+
+    /**
+     * @return the first whole pulse at or after the specified fixed-point position
+     */
+    static int64_t ceilToPulses(int64_t position);
+
+    /**
+     * Calculates the offset of a pulse inside of a block, distributing the block's pulses linearly over its samples.
+     *
+     * @param time the pulse
+     * @param blockStart the start of the block, in fixed-point pulses
+     * @param blockLength the length of the block, in fixed-point pulses; must be positive
+     * @param numSamples the number of samples in the block
+     * @return the sample offset, clamped into the block
+     */
+    static int sampleOffset(int64_t time, int64_t blockStart, int64_t blockLength, int numSamples);
+
+private:
+
+    double sampleRate = 0.0;
+    double bpm = 0.0;
+    int timebase = 0;
+
+    /**
+     * The number of fixed-point pulses per sample.
+     */
+    int64_t pulsesPerSample = 0;
+};
@@ -29,6 +29,18 @@ const juce::Identifier EditorState::TREEID_OFFSET_X = juce::Identifier("editorOf
 const juce::Identifier EditorState::TREEID_OFFSET_Y = juce::Identifier("editorOffsetY"); // NOLINT
 
 
+bool EditorState::isSavedEqual(const EditorState &other) const {
+    return width == other.width
+            && height == other.height
+            && divisor == other.divisor
+            && lastNoteLength == other.lastNoteLength
+            && lastNoteVelocity == other.lastNoteVelocity
+            && targetPixelsPerBeat == other.targetPixelsPerBeat
+            && targetPixelsPerNote == other.targetPixelsPerNote
+            && targetOffsetX == other.targetOffsetX
+            && targetOffsetY == other.targetOffsetY;
+}
+
 juce::ValueTree EditorState::toValueTree() const {
     juce::ValueTree tree = juce::ValueTree(TREEID_EDITOR_STATE);
     tree.setProperty(TREEID_WIDTH, this->width, nullptr);
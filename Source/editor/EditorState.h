@@ -58,6 +58,12 @@ struct EditorState {
     float displayOffsetX = 0;       ///< Actually displayed X-axis pattern editor offset (for animation)
     float displayOffsetY = 0;       ///< Actually displayed Y-axis pattern editor offset (for animation)
 
+    /**
+     * @return whether this state is saved the same as the specified one; the displayed values, which are only being
+     *         animated towards the target ones, are not compared
+     */
+    [[nodiscard]] bool isSavedEqual(const EditorState &other) const;
+
     [[nodiscard]] juce::ValueTree toValueTree() const;
     static EditorState fromValueTree(juce::ValueTree &tree);
 
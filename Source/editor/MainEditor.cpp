@@ -22,6 +22,7 @@
 
 
 const int RESIZER_SIZE = 10;
+const int AUDIO_UPDATE_RATE_HZ = 60;
 
 MainEditor::MainEditor(LibreArp &p, EditorState &e)
         : AudioProcessorEditor(&p),
@@ -30,8 +31,10 @@ MainEditor::MainEditor(LibreArp &p, EditorState &e)
           resizer(this, &boundsConstrainer),
           tabs(juce::TabbedButtonBar::Orientation::TabsAtTop),
           patternEditor(p, e),
+          presetBrowser(p),
           behaviourSettingsEditor(p),
-          settingsEditor(p) {
+          settingsEditor(p),
+          performanceEditor(p) {
 
     juce::LookAndFeel::setDefaultLookAndFeel(&LArpLookAndFeel::getInstance());
 
@@ -49,10 +52,14 @@ MainEditor::MainEditor(LibreArp &p, EditorState &e)
     tabs.setOutline(0);
     tabs.addTab("Pattern Editor",
             getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId), &patternEditor, false);
+    tabs.addTab("Presets",
+            getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId), &presetBrowser, false);
     tabs.addTab("Behaviour",
             getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId), &behaviourSettingsEditor, false);
     tabs.addTab("Global settings",
             getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId), &settingsEditor, false);
+    tabs.addTab("Performance",
+            getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId), &performanceEditor, false);
     tabs.addTab("About",
             getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId), &aboutBox, false);
 
@@ -61,6 +68,8 @@ MainEditor::MainEditor(LibreArp &p, EditorState &e)
     addAndMakeVisible(tabs);
     addAndMakeVisible(resizer, 9999);
     addChildComponent(updateButton, 9999);
+
+    startTimerHz(AUDIO_UPDATE_RATE_HZ);
 }
 
 MainEditor::~MainEditor() = default;
@@ -90,7 +99,14 @@ void MainEditor::resized() {
     updateLayout();
 }
 
-void MainEditor::handleAsyncUpdate() {
+void MainEditor::timerCallback() {
+    processor.deleteRetired();
+
+    // The processor only raises a flag, as posting a message from the audio thread could allocate
+    if (!processor.consumeEditorUpdate()) {
+        return;
+    }
+
     patternEditor.audioUpdate();
     behaviourSettingsEditor.audioUpdate();
 }
@@ -27,13 +27,15 @@
 #include "LArpLookAndFeel.h"
 #include "../AudioUpdatable.h"
 #include "behaviour/BehaviourSettingsEditor.h"
+#include "performance/PerformanceEditor.h"
+#include "presets/PresetBrowser.h"
 
 /**
  * Main LibreArp editor component.
  */
 class MainEditor :
         public juce::AudioProcessorEditor,
-        public juce::AsyncUpdater {
+        public juce::Timer {
 public:
 
     explicit MainEditor(LibreArp &, EditorState &);
@@ -45,7 +47,7 @@ public:
     void resized() override;
     void visibilityChanged() override;
 
-    void handleAsyncUpdate() override;
+    void timerCallback() override;
 
 private:
     LibreArp &processor;
@@ -60,8 +62,10 @@ private:
     juce::Label placeholderLabel;
 
     PatternEditorView patternEditor;
+    PresetBrowser presetBrowser;
     BehaviourSettingsEditor behaviourSettingsEditor;
     SettingsEditor settingsEditor;
+    PerformanceEditor performanceEditor;
     AboutBox aboutBox;
 
     juce::HyperlinkButton updateButton;
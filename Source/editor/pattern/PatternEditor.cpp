@@ -138,7 +138,9 @@ void PatternEditor::paint(juce::Graphics &g) {
 
     // Draw notes
     auto &notes = pattern.getNotes();
-    for (size_t i = 0; i < notes.size(); i++) {
+    std::vector<size_t> visibleNotes;
+    findNotesBetween(unoffsDrawRegion.getX(), unoffsDrawRegion.getRight(), visibleNotes);
+    for (auto i : visibleNotes) {
         auto &note = notes[i];
         juce::Rectangle<int> noteRect = getRectangleForNote(note);
 
@@ -252,7 +254,7 @@ void PatternEditor::mouseWheelMove(const juce::MouseEvent &event, const juce::Mo
                 state.lastNoteVelocity = note.data.velocity;
                 state.lastNoteLength = note.endPoint - note.startPoint;
             }
-            processor.buildPattern();
+            buildDraggedNotes();
         }
     } else {
         // Scrolling
@@ -363,7 +365,9 @@ void PatternEditor::mouseDetermineDragAction(const juce::MouseEvent& event) {
         "Drag to resize the loop\n"
         "Alt: disable snapping to grid";
 
-    for (uint64_t i = 0; i < notes.size(); i++) {
+    std::vector<size_t> hitNotes;
+    findNotesBetween(event.x, event.x + 1, hitNotes);
+    for (uint64_t i : hitNotes) {
         auto &note = notes[i];
         auto noteRect = getRectangleForNote(note);
         if (noteRect.contains(event.x, event.y)) {
@@ -632,7 +636,7 @@ void PatternEditor::noteStartResize(const juce::MouseEvent& event) {
     }
 
     getNoteSelectionBorder(timeSelectionStart, timeSelectionEnd);
-    processor.buildPattern();
+    buildDraggedNotes();
     repaintNotes();
     repaintSelectedNotes();
     mouseCursor = juce::MouseCursor::LeftEdgeResizeCursor;
@@ -656,7 +660,7 @@ void PatternEditor::noteEndResize(const juce::MouseEvent& event) {
     }
 
     getNoteSelectionBorder(timeSelectionStart, timeSelectionEnd);
-    processor.buildPattern();
+    buildDraggedNotes();
     repaintNotes();
     repaintSelectedNotes();
     mouseCursor = juce::MouseCursor::RightEdgeResizeCursor;
@@ -685,7 +689,7 @@ void PatternEditor::noteMove(const juce::MouseEvent& event) {
     }
 
     getNoteSelectionBorder(timeSelectionStart, timeSelectionEnd);
-    processor.buildPattern();
+    buildDraggedNotes();
     repaintNotes();
     repaintSelectedNotes();
 
@@ -699,7 +703,7 @@ void PatternEditor::noteDuplicate() {
     for (auto &noteOffset : dragAction.noteOffsets) {
         processor.getPattern().getNotes().push_back(notes[noteOffset.noteIndex]);
     }
-    processor.buildPattern();
+    processor.buildPattern(std::vector<size_t>()); // Only appended notes
     repaintNotes();
 }
 
@@ -718,7 +722,7 @@ void PatternEditor::noteResetVelocity() {
         auto &note = this->processor.getPattern().getNotes()[noteIndex];
         state.lastNoteLength = note.endPoint - note.startPoint;
     }
-    processor.buildPattern();
+    buildDraggedNotes();
     repaintNotes();
 }
 
@@ -741,7 +745,7 @@ void PatternEditor::noteCreate(const juce::MouseEvent &event) {
     auto index = notes.size();
     notes.push_back(note);
 
-    processor.buildPattern();
+    processor.buildPattern(std::vector<size_t>()); // Only appended notes
     repaintNotes();
 
     if (event.mods.isShiftDown()) {
@@ -758,12 +762,14 @@ void PatternEditor::noteDelete(const juce::MouseEvent &event) {
     auto &notes = pattern.getNotes();
     bool erased = false;
 
-    for (auto it = notes.begin(); it != notes.end(); it++) {
-        auto &note = *it;
+    std::vector<size_t> hitNotes;
+    findNotesBetween(event.x, event.x + 1, hitNotes);
+    for (auto i : hitNotes) {
+        auto &note = notes[i];
         auto noteRect = getRectangleForNote(note);
 
         if (noteRect.contains(event.x, event.y)) {
-            notes.erase(it);
+            notes.erase(notes.begin() + static_cast<std::ptrdiff_t>(i));
             erased = true;
             dragAction.basicDragAction();
             break;
@@ -820,7 +826,7 @@ void PatternEditor::moveSelectedUp(bool octave) {
             notes[index].data.noteNumber++;
         }
     }
-    processor.buildPattern();
+    processor.buildPattern(std::vector<size_t>(selectedNotes.begin(), selectedNotes.end()));
     repaintSelectedNotes();
 }
 
@@ -836,7 +842,7 @@ void PatternEditor::moveSelectedDown(bool octave) {
             notes[index].data.noteNumber--;
         }
     }
-    processor.buildPattern();
+    processor.buildPattern(std::vector<size_t>(selectedNotes.begin(), selectedNotes.end()));
     repaintSelectedNotes();
 }
 
@@ -852,7 +858,9 @@ void PatternEditor::select(const juce::MouseEvent& event) {
     }
 
     auto &notes = processor.getPattern().getNotes();
-    for(size_t i = 0; i < notes.size(); i++) {
+    std::vector<size_t> selectionNotes;
+    findNotesBetween(selection.getX(), selection.getRight(), selectionNotes);
+    for (auto i : selectionNotes) {
         auto &note = notes[i];
         auto noteRect = getRectangleForNote(note);
         if (selection.intersects(noteRect)) {
@@ -893,7 +901,7 @@ void PatternEditor::duplicateSelection(bool back) {
         addedNotes++;
     }
 
-    processor.buildPattern();
+    processor.buildPattern(std::vector<size_t>()); // Only appended notes
 
     if (addedNotes <= 0)
         return;
@@ -930,10 +938,33 @@ void PatternEditor::selectionStretch(int64_t selectionStart, int64_t selectionEn
     timeSelectionStart = selectionStart;
     timeSelectionEnd = selectionEnd;
     repaintSelectedNotes();
-    processor.buildPattern();
+
+    std::vector<size_t> changedNotes;
+    changedNotes.reserve(dragAction.selectedNotes.size());
+    for (auto &selectedNote : dragAction.selectedNotes) {
+        changedNotes.push_back(selectedNote.noteIndex);
+    }
+    processor.buildPattern(changedNotes);
+}
+
+void PatternEditor::buildDraggedNotes() {
+    std::vector<size_t> changedNotes;
+    changedNotes.reserve(dragAction.noteOffsets.size());
+    for (auto &noteOffset : dragAction.noteOffsets) {
+        changedNotes.push_back(noteOffset.noteIndex);
+    }
+    processor.buildPattern(changedNotes);
 }
 
 
+void PatternEditor::layerChanged() {
+    selectedNotes.clear();
+    timeSelectionStart = 0;
+    timeSelectionEnd = 0;
+    dragAction.basicDragAction();
+    repaint();
+}
+
 void PatternEditor::audioUpdate() {
     if (!processor.wasPlaying) {
         return;
@@ -982,22 +1013,20 @@ void PatternEditor::audioUpdate() {
 }
 
 void PatternEditor::repaintNotes() {
-    std::scoped_lock lock(processor.getPattern().getMutex());
-    auto &notes = processor.getPattern().getNotes();
-
-    if (notes.empty()) {
+    int64_t notesStart, notesEnd;
+    int minNoteNumber, maxNoteNumber;
+    if (!processor.getPattern().getNotesBounds(notesStart, notesEnd, minNoteNumber, maxNoteNumber)) {
         return;
     }
 
-    auto notesRect = juce::Rectangle<int>::leftTopRightBottom(INT32_MAX, INT32_MAX, 0, 0);
-    for(auto &note : notes) {
-        auto noteRect = getRectangleForNote(note);
-        notesRect.setLeft(juce::jmin(notesRect.getX(), noteRect.getX()));
-        notesRect.setTop(juce::jmin(notesRect.getY(), noteRect.getY()));
-        notesRect.setRight(juce::jmax(notesRect.getRight(), noteRect.getRight()));
-        notesRect.setBottom(juce::jmax(notesRect.getBottom(), noteRect.getBottom()));
-    }
-    repaint(notesRect);
+    int pixelsPerNote = state.displayPixelsPerNote;
+
+    // Note rectangles may exceed the converted end by a pixel or two due to rounding
+    repaint(juce::Rectangle<int>::leftTopRightBottom(
+            pulseToX(notesStart),
+            noteToY(maxNoteNumber),
+            pulseToX(notesEnd) + 2,
+            noteToY(minNoteNumber) + pixelsPerNote));
 }
 
 void PatternEditor::repaintSelectedNotes() {
@@ -1039,6 +1068,13 @@ juce::Rectangle<int> PatternEditor::getRectangleForNote(ArpNote &note) {
     };
 }
 
+void PatternEditor::findNotesBetween(int left, int right, std::vector<size_t> &result) {
+    // Widened by a couple of pixels to account for rounding in the pulse conversions
+    auto from = xToPulse(left - 2, false);
+    auto to = xToPulse(right + 2, false) + 1;
+    processor.getPattern().findNotes(from, to, result);
+}
+
 bool PatternEditor::getNoteSelectionBorder(std::set<uint64_t>& indices,
                                            std::vector<ArpNote>& allNotes,
                                            int64_t& out_start, int64_t& out_end) {
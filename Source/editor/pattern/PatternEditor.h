@@ -207,6 +207,11 @@ public:
 
     void audioUpdate() override;
 
+    /**
+     * Resets the selection and repaints, after a different layer has been selected for editing.
+     */
+    void layerChanged();
+
 private:
 
     /**
@@ -383,6 +388,12 @@ private:
      */
     void selectionStretch(int64_t selectionStart, int64_t selectionEnd);
 
+    /**
+     * Builds the pattern after the notes of the current drag action have been changed, letting other notes keep
+     * playing.
+     */
+    void buildDraggedNotes();
+
 
 
     /**
@@ -420,6 +431,17 @@ private:
      */
     juce::Rectangle<int> getRectangleForNote(ArpNote &note);
 
+    /**
+     * Finds the notes that may be rendered between the specified view-space X coordinates, using the pattern's note
+     * index. The result may contain a few extra notes around the edges, so the rectangles of the found notes still need
+     * to be checked.
+     *
+     * @param left the left X coordinate
+     * @param right the right X coordinate
+     * @param result the vector the indices of the found notes are written into, in ascending order
+     */
+    void findNotesBetween(int left, int right, std::vector<size_t> &result);
+
     /**
      * Gets the pulse border of selected notes and writes the result into `outStart` and `outEnd`. The border consists
      * of the lowest `startPoint` and the highest `endPoint` of the selected notes.
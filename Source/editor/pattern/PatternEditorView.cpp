@@ -22,6 +22,16 @@ static const int Y_ZOOM_RATE = 30;
 static const int X_SCROLL_RATE = 250;
 static const int Y_SCROLL_RATE = 250;
 
+static const int GROOVE_SINE_ID = 1;
+static const int GROOVE_MPC_FIRST_ID = 2;
+static const int GROOVE_CUSTOM_ID = 100;
+static const int GROOVE_LOAD_ID = 101;
+
+static const double MPC_SWING_PERCENTAGES[] = { 0.54, 0.58, 0.62, 0.66, 0.71, 0.75 };
+
+static const int LAYER_ADD_ID = 100;
+static const int LAYER_REMOVE_ID = 101;
+
 PatternEditorView::PatternEditorView(LibreArp &p, EditorState &e)
         : processor(p),
           state(e),
@@ -29,6 +39,10 @@ PatternEditorView::PatternEditorView(LibreArp &p, EditorState &e)
                   "Pattern preset",
                   processor.getGlobals().getPatternPresetsDir(),
                   "*.lapreset"),
+          grooveChooser(
+                  "Groove MIDI file",
+                  juce::File::getSpecialLocation(juce::File::userHomeDirectory),
+                  "*.mid;*.midi"),
           editor(p, state, *this),
           beatBar(p, state, *this),
           noteBar(p, state, *this)
@@ -138,6 +152,65 @@ PatternEditorView::PatternEditorView(LibreArp &p, EditorState &e)
     swingSliderLabel.setText("Swing:", juce::NotificationType::dontSendNotification);
     swingSliderLabel.setJustificationType(juce::Justification::centredRight);
     addAndMakeVisible(swingSliderLabel);
+
+    {
+        grooveMenu.addItem("Sine swing", GROOVE_SINE_ID);
+        int id = GROOVE_MPC_FIRST_ID;
+        for (auto percentage : MPC_SWING_PERCENTAGES) {
+            grooveMenu.addItem(GrooveTemplate::mpcSwing(percentage).name, id++);
+        }
+        grooveMenu.addSeparator();
+        grooveMenu.addItem("Custom", GROOVE_CUSTOM_ID);
+        grooveMenu.addItem("Load from MIDI file...", GROOVE_LOAD_ID);
+    }
+    grooveMenu.setEditableText(false);
+    grooveMenu.setTooltip("The feel applied by swing. Swing blends between straight timing and the full groove.");
+    grooveMenu.onChange = [this] {
+        auto id = grooveMenu.getSelectedId();
+        auto mpcIndex = id - GROOVE_MPC_FIRST_ID;
+        if (id == GROOVE_SINE_ID) {
+            processor.setGroove(GrooveTemplate::sine());
+        } else if (juce::isPositiveAndBelow(mpcIndex, juce::numElementsInArray(MPC_SWING_PERCENTAGES))) {
+            processor.setGroove(GrooveTemplate::mpcSwing(MPC_SWING_PERCENTAGES[mpcIndex]));
+        } else if (id == GROOVE_LOAD_ID) {
+            using Flags = juce::FileBrowserComponent::FileChooserFlags;
+            grooveChooser.launchAsync(
+                    Flags::openMode | Flags::canSelectFiles,
+                    [this](auto& chooser) {
+                        auto results = chooser.getResults();
+                        if (!results.isEmpty() && results[0].existsAsFile()) {
+                            try {
+                                processor.setGroove(GrooveTemplate::fromMidiFile(results[0]));
+                            } catch (std::invalid_argument &e) {
+                                juce::AlertWindow::showMessageBoxAsync(
+                                        juce::AlertWindow::WarningIcon,
+                                        "Could not load groove",
+                                        e.what());
+                            }
+                        }
+                        updateGrooveMenu();
+                    });
+        }
+    };
+    addAndMakeVisible(grooveMenu);
+
+    layerMenu.setEditableText(false);
+    layerMenu.setTooltip("The edited layer. All layers are played at the same time, each with its own swing, octave "
+                         "and output channel settings.");
+    layerMenu.onChange = [this] {
+        auto id = layerMenu.getSelectedId();
+        if (id == LAYER_ADD_ID) {
+            processor.addLayer();
+        } else if (id == LAYER_REMOVE_ID) {
+            processor.removeLayer(processor.getEditedLayer());
+        } else if (id > 0) {
+            processor.setEditedLayer(id - 1);
+        }
+        editor.layerChanged();
+        updateParameterValues();
+        repaint();
+    };
+    addAndMakeVisible(layerMenu);
 }
 
 void PatternEditorView::resized() {
@@ -248,6 +321,47 @@ void PatternEditorView::updateParameterValues() {
     snapMenu.setSelectedId(state.divisor, juce::NotificationType::dontSendNotification);
     swingSlider.setValue(processor.getSwing(), juce::NotificationType::dontSendNotification);
     bypassToggle.setToggleState(processor.getBypass(), juce::NotificationType::dontSendNotification);
+    updateGrooveMenu();
+    updateLayerMenu();
+}
+
+void PatternEditorView::updateGrooveMenu() {
+    auto &groove = processor.getGroove();
+
+    int id = GROOVE_CUSTOM_ID;
+    if (groove == GrooveTemplate::sine()) {
+        id = GROOVE_SINE_ID;
+    } else {
+        for (int i = 0; i < juce::numElementsInArray(MPC_SWING_PERCENTAGES); i++) {
+            if (groove == GrooveTemplate::mpcSwing(MPC_SWING_PERCENTAGES[i])) {
+                id = GROOVE_MPC_FIRST_ID + i;
+                break;
+            }
+        }
+    }
+
+    grooveMenu.changeItemText(GROOVE_CUSTOM_ID, (id == GROOVE_CUSTOM_ID) ? groove.name : juce::String("Custom"));
+    grooveMenu.setItemEnabled(GROOVE_CUSTOM_ID, id == GROOVE_CUSTOM_ID);
+    grooveMenu.setSelectedId(id, juce::NotificationType::dontSendNotification);
+}
+
+void PatternEditorView::updateLayerMenu() {
+    auto numLayers = processor.getNumLayers();
+
+    // Layer items and the add and remove items; the separator is not counted
+    if (layerMenu.getNumItems() != numLayers + 2) {
+        layerMenu.clear(juce::NotificationType::dontSendNotification);
+        for (int i = 0; i < numLayers; i++) {
+            layerMenu.addItem("Layer " + juce::String(i + 1), i + 1);
+        }
+        layerMenu.addSeparator();
+        layerMenu.addItem("Add layer", LAYER_ADD_ID);
+        layerMenu.addItem("Remove layer", LAYER_REMOVE_ID);
+    }
+
+    layerMenu.setItemEnabled(LAYER_ADD_ID, numLayers < LibreArp::MAX_LAYERS);
+    layerMenu.setItemEnabled(LAYER_REMOVE_ID, numLayers > 1);
+    layerMenu.setSelectedId(processor.getEditedLayer() + 1, juce::NotificationType::dontSendNotification);
 }
 
 void PatternEditorView::updateLayout() {
@@ -267,6 +381,8 @@ void PatternEditorView::updateLayout() {
     toolBarArea.removeFromLeft(16);
     swingSliderLabel.setBounds(toolBarArea.removeFromLeft(8 + swingSliderLabel.getFont().getStringWidth(swingSliderLabel.getText())));
     swingSlider.setBounds(toolBarArea.removeFromLeft(128));
+    toolBarArea.removeFromLeft(8);
+    grooveMenu.setBounds(toolBarArea.removeFromLeft(144));
 
     snapMenu.setBounds(toolBarArea.removeFromRight(96));
     snapMenuLabel.setBounds(toolBarArea.removeFromRight(64));
@@ -277,6 +393,7 @@ void PatternEditorView::updateLayout() {
     loadButton.setBounds(bottomButtonArea.removeFromLeft(100));
     saveButton.setBounds(bottomButtonArea.removeFromLeft(100));
     bottomButtonArea.removeFromLeft(24);
+    layerMenu.setBounds(bottomButtonArea.removeFromLeft(120));
     bypassToggle.setBounds(bottomButtonArea.removeFromRight(80));
 
     area.removeFromBottom(8);
@@ -47,6 +47,7 @@ private:
     EditorState &state;
 
     juce::FileChooser presetChooser;
+    juce::FileChooser grooveChooser;
 
     juce::TextButton saveButton;
     juce::TextButton loadButton;
@@ -61,12 +62,18 @@ private:
     juce::Slider swingSlider;
     juce::Label swingSliderLabel;
 
+    juce::ComboBox grooveMenu;
+
+    juce::ComboBox layerMenu;
+
     PatternEditor editor;
     BeatBar beatBar;
     NoteBar noteBar;
     juce::TextButton recentreButton;
 
     void updateParameterValues();
+    void updateGrooveMenu();
+    void updateLayerMenu();
     void updateLayout();
 };
 
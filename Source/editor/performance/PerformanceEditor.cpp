@@ -0,0 +1,239 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "../LArpLookAndFeel.h"
+#include "../style/Colours.h"
+#include "PerformanceEditor.h"
+
+static const int UPDATE_RATE_HZ = 4;
+static const int HISTOGRAM_HEIGHT = 128;
+
+static juce::String formatNanos(double nanos) {
+    if (nanos >= 1e6) {
+        return juce::String(nanos / 1e6, 2) + " ms";
+    }
+    return juce::String(nanos / 1e3, 1) + juce::String(juce::CharPointer_UTF8(" \xc2\xb5s"));
+}
+
+static juce::String formatBucket(int index) {
+    auto micros = PerformanceStats::getBucketLowerBoundMicros(index);
+    if (index == 0) {
+        return juce::String(juce::CharPointer_UTF8("<1\xc2\xb5s"));
+    }
+
+    auto text = (micros >= 1000)
+        ? juce::String(micros / 1000) + "ms"
+        : juce::String(micros) + juce::String(juce::CharPointer_UTF8("\xc2\xb5s"));
+    return (index == PerformanceStats::NUM_BUCKETS - 1) ? text + "+" : text;
+}
+
+static juce::String formatPerBlock(uint64_t total, uint64_t numBlocks) {
+    auto perBlock = (numBlocks > 0) ? static_cast<double>(total) / static_cast<double>(numBlocks) : 0.0;
+    return juce::String(total) + " (" + juce::String(perBlock, 2) + " per block)";
+}
+
+
+PerformanceEditor::PerformanceEditor(LibreArp &p) : processor(p) {
+    loadTitle.setText("Processing load", juce::NotificationType::dontSendNotification);
+
+    const juce::String budgetTooltip = "Blocks whose processing takes longer than this portion of their realtime "
+        "duration are counted as over budget.";
+    budgetSlider.setSliderStyle(juce::Slider::SliderStyle::IncDecButtons);
+    budgetSlider.setTextBoxStyle(juce::Slider::TextEntryBoxPosition::TextBoxLeft, false, 42, 24);
+    budgetSlider.setTooltip(budgetTooltip);
+    budgetSlider.setRange(1, 100, 1);
+    budgetSlider.setTextValueSuffix("%");
+    budgetSlider.setValue(processor.getPerformanceStats().getBudget() * 100.0,
+                          juce::NotificationType::dontSendNotification);
+    budgetSlider.onValueChange = [this] {
+        processor.getPerformanceStats().setBudget(budgetSlider.getValue() / 100.0);
+    };
+    budgetLabel.setText("Budget per block", juce::NotificationType::dontSendNotification);
+    budgetLabel.setTooltip(budgetTooltip);
+
+    resetButton.setButtonText("Reset");
+    resetButton.setTooltip("Clears the collected statistics");
+    resetButton.onClick = [this] {
+        processor.getPerformanceStats().reset();
+    };
+
+    histogramTitle.setText("Block processing times", juce::NotificationType::dontSendNotification);
+    eventsTitle.setText("Events", juce::NotificationType::dontSendNotification);
+    patternTitle.setText("Pattern", juce::NotificationType::dontSendNotification);
+
+    addAndMakeVisible(loadTitle);
+    addAndMakeVisible(blocksLabel);
+    addAndMakeVisible(meanLabel);
+    addAndMakeVisible(maxLabel);
+    addAndMakeVisible(lastLabel);
+    addAndMakeVisible(overBudgetLabel);
+    addAndMakeVisible(budgetSlider);
+    addAndMakeVisible(budgetLabel);
+    addAndMakeVisible(resetButton);
+    addAndMakeVisible(histogramTitle);
+    addAndMakeVisible(histogram);
+    addAndMakeVisible(eventsTitle);
+    addAndMakeVisible(emittedEventsLabel);
+    addAndMakeVisible(scannedEventsLabel);
+    addAndMakeVisible(patternTitle);
+    addAndMakeVisible(patternLabel);
+}
+
+void PerformanceEditor::resized() {
+    updateLayout();
+}
+
+void PerformanceEditor::visibilityChanged() {
+    Component::visibilityChanged();
+
+    if (isVisible()) {
+        updateStats();
+        startTimerHz(UPDATE_RATE_HZ);
+    } else {
+        stopTimer();
+    }
+
+    updateLayout();
+}
+
+void PerformanceEditor::timerCallback() {
+    updateStats();
+}
+
+void PerformanceEditor::updateStats() {
+    auto snapshot = processor.getPerformanceStats().getSnapshot();
+
+    auto overBudgetPercent = (snapshot.numBlocks > 0)
+        ? 100.0 * static_cast<double>(snapshot.numOverBudgetBlocks) / static_cast<double>(snapshot.numBlocks)
+        : 0.0;
+
+    blocksLabel.setText("Blocks: " + juce::String(snapshot.numBlocks),
+                        juce::NotificationType::dontSendNotification);
+    meanLabel.setText("Mean: " + formatNanos(snapshot.getMeanNanos()),
+                      juce::NotificationType::dontSendNotification);
+    maxLabel.setText("Max: " + formatNanos(static_cast<double>(snapshot.maxNanos)),
+                     juce::NotificationType::dontSendNotification);
+    lastLabel.setText("Last: " + formatNanos(static_cast<double>(snapshot.lastNanos)),
+                      juce::NotificationType::dontSendNotification);
+    overBudgetLabel.setText("Over budget: " + juce::String(snapshot.numOverBudgetBlocks)
+                                + " (" + juce::String(overBudgetPercent, 2) + "%)",
+                            juce::NotificationType::dontSendNotification);
+
+    emittedEventsLabel.setText("MIDI events sent: " + formatPerBlock(snapshot.numEmittedEvents, snapshot.numBlocks),
+                               juce::NotificationType::dontSendNotification);
+    scannedEventsLabel.setText("Pattern events scanned: " + formatPerBlock(snapshot.numScannedEvents, snapshot.numBlocks),
+                               juce::NotificationType::dontSendNotification);
+
+    auto &pattern = processor.getPattern();
+    auto beats = static_cast<double>(pattern.loopLength()) / pattern.getTimebase();
+    patternLabel.setText(juce::String(pattern.getNotes().size()) + " notes, "
+                             + juce::String(beats, 2) + " beats long",
+                         juce::NotificationType::dontSendNotification);
+
+    histogram.setSnapshot(snapshot);
+}
+
+void PerformanceEditor::updateLayout() {
+    if (!isVisible()) {
+        return;
+    }
+
+    auto area = getLocalBounds().reduced(LArpLookAndFeel::MARGIN);
+
+
+    //
+    loadTitle.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    area.removeFromTop(LArpLookAndFeel::COMPONENT_SEP);
+
+    blocksLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    meanLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    maxLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    lastLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    overBudgetLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+
+    area.removeFromTop(LArpLookAndFeel::COMPONENT_SEP);
+
+    auto budgetArea = area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT);
+    budgetSlider.setBounds(budgetArea.removeFromLeft(96));
+    resetButton.setBounds(budgetArea.removeFromRight(100));
+    budgetLabel.setBounds(budgetArea);
+
+
+    //
+    area.removeFromTop(LArpLookAndFeel::SECTION_SEP);
+    histogramTitle.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    area.removeFromTop(LArpLookAndFeel::COMPONENT_SEP);
+
+    histogram.setBounds(area.removeFromTop(HISTOGRAM_HEIGHT));
+
+
+    //
+    area.removeFromTop(LArpLookAndFeel::SECTION_SEP);
+    eventsTitle.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    area.removeFromTop(LArpLookAndFeel::COMPONENT_SEP);
+
+    emittedEventsLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    scannedEventsLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+
+
+    //
+    area.removeFromTop(LArpLookAndFeel::SECTION_SEP);
+    patternTitle.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+    area.removeFromTop(LArpLookAndFeel::COMPONENT_SEP);
+
+    patternLabel.setBounds(area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT));
+}
+
+
+void PerformanceEditor::Histogram::paint(juce::Graphics &g) {
+    g.setColour(Style::EDITOR_BACKGROUND_COLOUR);
+    g.fillRect(getLocalBounds());
+
+    uint64_t maxCount = 0;
+    for (auto count : snapshot.histogram) {
+        maxCount = juce::jmax(maxCount, count);
+    }
+
+    auto area = getLocalBounds().reduced(LArpLookAndFeel::COMPONENT_SEP);
+    auto labelArea = area.removeFromBottom(16);
+    auto barWidth = static_cast<float>(area.getWidth()) / PerformanceStats::NUM_BUCKETS;
+
+    g.setFont(11.0f);
+    for (int i = 0; i < PerformanceStats::NUM_BUCKETS; i++) {
+        auto x = static_cast<float>(area.getX()) + barWidth * static_cast<float>(i);
+
+        if (maxCount > 0 && snapshot.histogram[static_cast<size_t>(i)] > 0) {
+            auto ratio = static_cast<float>(snapshot.histogram[static_cast<size_t>(i)])
+                    / static_cast<float>(maxCount);
+            auto height = juce::jmax(1.0f, static_cast<float>(area.getHeight()) * ratio);
+
+            g.setColour(Style::NOTE_FILL_COLOUR);
+            g.fillRect(x + 1.0f, static_cast<float>(area.getBottom()) - height, barWidth - 2.0f, height);
+        }
+
+        g.setColour(Style::MAIN_FOREGROUND_COLOUR);
+        g.drawText(formatBucket(i),
+                   juce::Rectangle<float>(x, static_cast<float>(labelArea.getY()),
+                                          barWidth, static_cast<float>(labelArea.getHeight())),
+                   juce::Justification::centred);
+    }
+}
+
+void PerformanceEditor::Histogram::setSnapshot(const PerformanceStats::Snapshot &newSnapshot) {
+    this->snapshot = newSnapshot;
+    repaint();
+}
@@ -0,0 +1,78 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "../../LibreArp.h"
+#include "../generic/Title.h"
+
+/**
+ * Displays the performance statistics of the processor, so that costly instances and patterns can be found without
+ * attaching a profiler.
+ */
+class PerformanceEditor : public juce::Component, private juce::Timer {
+public:
+
+    explicit PerformanceEditor(LibreArp &p);
+
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+
+    /**
+     * Draws the histogram of block processing times.
+     */
+    class Histogram : public juce::Component {
+    public:
+        void paint(juce::Graphics &g) override;
+        void setSnapshot(const PerformanceStats::Snapshot &snapshot);
+
+    private:
+        PerformanceStats::Snapshot snapshot;
+    };
+
+    LibreArp &processor;
+
+    Title loadTitle;
+    juce::Label blocksLabel;
+    juce::Label meanLabel;
+    juce::Label maxLabel;
+    juce::Label lastLabel;
+    juce::Label overBudgetLabel;
+    juce::Slider budgetSlider;
+    juce::Label budgetLabel;
+    juce::TextButton resetButton;
+
+    Title histogramTitle;
+    Histogram histogram;
+
+    Title eventsTitle;
+    juce::Label emittedEventsLabel;
+    juce::Label scannedEventsLabel;
+
+    Title patternTitle;
+    juce::Label patternLabel;
+
+    void timerCallback() override;
+
+    void updateStats();
+    void updateLayout();
+
+};
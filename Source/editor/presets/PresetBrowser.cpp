@@ -0,0 +1,284 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+
+#include "../LArpLookAndFeel.h"
+#include "../style/Colours.h"
+#include "PresetBrowser.h"
+
+static const int UPDATE_RATE_HZ = 4;
+static const int BUTTON_WIDTH = 100;
+static const int STATUS_WIDTH = 200;
+static const int DETAILS_WIDTH = 180;
+
+static juce::String describeEntry(const PresetLibrary::Entry &entry) {
+    auto beats = (entry.timebase > 0) ? static_cast<double>(entry.loopLength) / entry.timebase : 0.0;
+    return juce::String(entry.numNotes) + " notes, " + juce::String(beats, 2) + " beats long";
+}
+
+
+PresetBrowser::PresetBrowser(LibreArp &p)
+        : processor(p),
+          entries(std::make_shared<const PresetLibrary::Entries>()) {
+
+    searchBox.setTextToShowWhenEmpty("Search presets...", Style::MAIN_FOREGROUND_COLOUR);
+    searchBox.setTooltip("Shows the presets whose names contain all of the words");
+    searchBox.onTextChange = [this] {
+        updateFilter();
+    };
+    addAndMakeVisible(searchBox);
+
+    rescanButton.setButtonText("Rescan");
+    rescanButton.setTooltip("Looks for new, changed and removed presets in the presets directory");
+    rescanButton.onClick = [this] {
+        library->refresh();
+    };
+    addAndMakeVisible(rescanButton);
+
+    statusLabel.setJustificationType(juce::Justification::centredRight);
+    addAndMakeVisible(statusLabel);
+
+    list.setModel(this);
+    list.setRowHeight(LArpLookAndFeel::COMPONENT_HEIGHT);
+    list.setColour(juce::ListBox::backgroundColourId, Style::HIGHLIGHT_BACKGROUND_COLOUR);
+    addAndMakeVisible(list);
+
+    auditionLabel.setJustificationType(juce::Justification::centredLeft);
+    addAndMakeVisible(auditionLabel);
+
+    keepButton.setButtonText("Keep");
+    keepButton.setTooltip("Keeps the auditioned preset in the edited layer");
+    keepButton.onClick = [this] {
+        keepAudition();
+    };
+    addAndMakeVisible(keepButton);
+
+    revertButton.setButtonText("Revert");
+    revertButton.setTooltip("Restores the pattern of the edited layer from before the audition");
+    revertButton.onClick = [this] {
+        revertAudition();
+    };
+    addAndMakeVisible(revertButton);
+}
+
+void PresetBrowser::resized() {
+    updateLayout();
+}
+
+void PresetBrowser::visibilityChanged() {
+    Component::visibilityChanged();
+
+    if (isVisible()) {
+        auto &globals = processor.getGlobals();
+        library->setLocation(globals.getPatternPresetsDir(), globals.getPresetIndexFile());
+        library->refresh();
+        updateEntries();
+        startTimerHz(UPDATE_RATE_HZ);
+    } else {
+        // The layer and the state are not watched while hidden
+        keepAudition();
+        stopTimer();
+    }
+
+    updateLayout();
+}
+
+
+int PresetBrowser::getNumRows() {
+    return static_cast<int>(visibleEntries.size());
+}
+
+void PresetBrowser::paintListBoxItem(int rowNumber, juce::Graphics &g, int width, int height, bool rowIsSelected) {
+    if (!juce::isPositiveAndBelow(rowNumber, getNumRows())) {
+        return;
+    }
+
+    auto &entry = (*entries)[visibleEntries[static_cast<size_t>(rowNumber)]];
+
+    if (rowIsSelected) {
+        g.fillAll(Style::HIGHLIGHT_FOREGROUND_COLOUR.withAlpha(0.3f));
+    }
+
+    auto area = juce::Rectangle<int>(0, 0, width, height).reduced(LArpLookAndFeel::MARGIN, 0);
+    g.setColour(Style::MAIN_FOREGROUND_COLOUR);
+    g.drawText(describeEntry(entry), area.removeFromRight(DETAILS_WIDTH), juce::Justification::centredRight, true);
+    g.setColour(rowIsSelected ? Style::HIGHLIGHT_TEXT_COLOUR : Style::MAIN_FOREGROUND_COLOUR);
+    g.drawText(entry.name, area, juce::Justification::centredLeft, true);
+}
+
+void PresetBrowser::selectedRowsChanged(int lastRowSelected) {
+    if (juce::isPositiveAndBelow(lastRowSelected, getNumRows())) {
+        audition((*entries)[visibleEntries[static_cast<size_t>(lastRowSelected)]]);
+    }
+}
+
+void PresetBrowser::listBoxItemDoubleClicked(int, const juce::MouseEvent &) {
+    keepAudition();
+}
+
+void PresetBrowser::returnKeyPressed(int) {
+    keepAudition();
+}
+
+
+void PresetBrowser::timerCallback() {
+    if (library->getGeneration() != entriesGeneration) {
+        updateEntries();
+    }
+
+    if (isAuditioning() && !isAuditionRevertible()) {
+        keepAudition();
+    }
+
+    updateStatus();
+}
+
+void PresetBrowser::updateEntries() {
+    entriesGeneration = library->getGeneration();
+    entries = library->getEntries();
+    updateFilter();
+}
+
+void PresetBrowser::updateFilter() {
+    auto terms = juce::StringArray::fromTokens(searchBox.getText(), true);
+    terms.removeEmptyStrings();
+
+    visibleEntries.clear();
+    for (size_t i = 0; i < entries->size(); i++) {
+        auto &name = (*entries)[i].name;
+        auto matches = std::all_of(terms.begin(), terms.end(), [&name](const juce::String &term) {
+            return name.containsIgnoreCase(term);
+        });
+        if (matches) {
+            visibleEntries.push_back(i);
+        }
+    }
+
+    list.updateContent();
+
+    // Keep the auditioned preset selected, without auditioning it again
+    juce::SparseSet<int> selection;
+    for (size_t row = 0; row < visibleEntries.size(); row++) {
+        if ((*entries)[visibleEntries[row]].path == auditionedPath) {
+            selection.addRange({ static_cast<int>(row), static_cast<int>(row) + 1 });
+            break;
+        }
+    }
+    list.setSelectedRows(selection, juce::NotificationType::dontSendNotification);
+    list.repaint();
+
+    updateStatus();
+}
+
+void PresetBrowser::updateStatus() {
+    auto status = juce::String(visibleEntries.size()) + " of " + juce::String(entries->size()) + " presets";
+    if (library->isScanning()) {
+        status += " (scanning...)";
+    }
+    statusLabel.setText(status, juce::NotificationType::dontSendNotification);
+
+    auto auditionText = (isAuditioning())
+        ? "Auditioning " + auditionedPath.upToLastOccurrenceOf(".", false, false)
+        : juce::String("Select a preset to audition it in the edited layer");
+    auditionLabel.setText(auditionText, juce::NotificationType::dontSendNotification);
+
+    keepButton.setEnabled(isAuditioning());
+    revertButton.setEnabled(isAuditioning());
+}
+
+void PresetBrowser::updateLayout() {
+    if (!isVisible()) {
+        return;
+    }
+
+    auto area = getLocalBounds().reduced(LArpLookAndFeel::MARGIN);
+
+    auto searchArea = area.removeFromTop(LArpLookAndFeel::COMPONENT_HEIGHT);
+    rescanButton.setBounds(searchArea.removeFromRight(BUTTON_WIDTH));
+    searchArea.removeFromRight(LArpLookAndFeel::MARGIN);
+    statusLabel.setBounds(searchArea.removeFromRight(STATUS_WIDTH));
+    searchArea.removeFromRight(LArpLookAndFeel::MARGIN);
+    searchBox.setBounds(searchArea);
+
+    area.removeFromTop(LArpLookAndFeel::MARGIN);
+
+    auto auditionArea = area.removeFromBottom(LArpLookAndFeel::COMPONENT_HEIGHT);
+    revertButton.setBounds(auditionArea.removeFromRight(BUTTON_WIDTH));
+    keepButton.setBounds(auditionArea.removeFromRight(BUTTON_WIDTH));
+    auditionArea.removeFromRight(LArpLookAndFeel::MARGIN);
+    auditionLabel.setBounds(auditionArea);
+
+    area.removeFromBottom(LArpLookAndFeel::MARGIN);
+
+    list.setBounds(area);
+}
+
+
+void PresetBrowser::audition(const PresetLibrary::Entry &entry) {
+    auto file = library->getPresetsDir().getChildFile(entry.path);
+    if (!file.existsAsFile()) {
+        library->refresh(); // Removed since the last scan
+        return;
+    }
+
+    bool loaded;
+    auto pattern = ArpPattern::fromFile(file, &loaded);
+    if (!loaded) {
+        library->refresh(); // Changed into something unreadable since the last scan
+        return;
+    }
+
+    if (isAuditioning() && !isAuditionRevertible()) {
+        keepAudition();
+    }
+    if (!isAuditioning()) {
+        auditionBackup = processor.getPattern();
+        auditionLayer = processor.getEditedLayer();
+        auditionRestoreGeneration = processor.getRestoreGeneration();
+    }
+
+    auditionedPath = entry.path;
+    processor.setPattern(pattern);
+    updateStatus();
+}
+
+void PresetBrowser::keepAudition() {
+    auditionLayer = -1;
+    auditionBackup = ArpPattern();
+    updateStatus();
+}
+
+void PresetBrowser::revertAudition() {
+    // The backup must not overwrite another layer, or a pattern restored since the audition started
+    if (isAuditioning() && isAuditionRevertible()) {
+        processor.setPattern(auditionBackup);
+    }
+
+    keepAudition();
+    auditionedPath.clear();
+    list.deselectAllRows();
+}
+
+bool PresetBrowser::isAuditioning() const {
+    return auditionLayer >= 0;
+}
+
+bool PresetBrowser::isAuditionRevertible() const {
+    return processor.getEditedLayer() == auditionLayer
+            && processor.getRestoreGeneration() == auditionRestoreGeneration;
+}
@@ -0,0 +1,92 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "../../LibreArp.h"
+#include "../../PresetLibrary.h"
+
+/**
+ * Browses and searches the indexed pattern presets. Selecting a preset auditions it in the edited layer; the
+ * audition can then be kept or reverted to the pattern from before.
+ */
+class PresetBrowser : public juce::Component, private juce::ListBoxModel, private juce::Timer {
+public:
+
+    explicit PresetBrowser(LibreArp &p);
+
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+
+    LibreArp &processor;
+    juce::SharedResourcePointer<PresetLibrary> library;
+
+    juce::TextEditor searchBox;
+    juce::TextButton rescanButton;
+    juce::Label statusLabel;
+    juce::ListBox list;
+    juce::Label auditionLabel;
+    juce::TextButton keepButton;
+    juce::TextButton revertButton;
+
+    /**
+     * The index as of the last update, and the indices of its entries matching the search.
+     */
+    std::shared_ptr<const PresetLibrary::Entries> entries;
+    std::vector<size_t> visibleEntries;
+    uint64_t entriesGeneration = 0;
+
+    /**
+     * The pattern of the edited layer from before the audition, along with the layer and the restore generation of
+     * the processor the audition started in.
+     */
+    ArpPattern auditionBackup;
+    int auditionLayer = -1;
+    uint64_t auditionRestoreGeneration = 0;
+    juce::String auditionedPath;
+
+    int getNumRows() override;
+    void paintListBoxItem(int rowNumber, juce::Graphics &g, int width, int height, bool rowIsSelected) override;
+    void selectedRowsChanged(int lastRowSelected) override;
+    void listBoxItemDoubleClicked(int row, const juce::MouseEvent &event) override;
+    void returnKeyPressed(int lastRowSelected) override;
+
+    void timerCallback() override;
+
+    void updateEntries();
+    void updateFilter();
+    void updateStatus();
+    void updateLayout();
+
+    void audition(const PresetLibrary::Entry &entry);
+    void keepAudition();
+    void revertAudition();
+    bool isAuditioning() const;
+
+    /**
+     * @return whether the audition can still be reverted - the edited layer is the auditioned one, and no state has
+     *         been restored since the audition started
+     */
+    bool isAuditionRevertible() const;
+};
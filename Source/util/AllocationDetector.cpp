@@ -0,0 +1,260 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "AllocationDetector.h"
+
+#if LIBREARP_DETECT_ALLOCATIONS
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <juce_core/juce_core.h>
+
+// NOTE: The thread-locals are accessed from within malloc, so they must not be allocated lazily (which glibc does
+//       for dynamically loaded libraries, using malloc)
+#if defined(__GLIBC__)
+    #define LIBREARP_HOOK_TLS __attribute__((tls_model("initial-exec")))
+#else
+    #define LIBREARP_HOOK_TLS
+#endif
+
+static thread_local int scopeDepth LIBREARP_HOOK_TLS = 0;
+static thread_local bool reporting LIBREARP_HOOK_TLS = false;
+static std::atomic<uint64_t> numDetectedAllocations = 0;
+
+static void onAllocation(size_t size) {
+    if (scopeDepth == 0 || reporting) {
+        return;
+    }
+
+    // Reporting may allocate by itself
+    reporting = true;
+    numDetectedAllocations++;
+    std::fprintf(stderr, "LibreArp: %zu byte allocation on the audio thread\n", size);
+    jassertfalse;
+    reporting = false;
+}
+
+#if defined(__GLIBC__)
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+
+    void *malloc(size_t size) {
+        onAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size) {
+        onAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size) {
+        onAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+
+    void *memalign(size_t alignment, size_t size) {
+        onAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size) {
+        onAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **ptr, size_t alignment, size_t size) {
+        if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+            return EINVAL;
+        }
+
+        onAllocation(size);
+        auto result = __libc_memalign(alignment, size);
+        if (result == nullptr) {
+            return ENOMEM;
+        }
+        *ptr = result;
+        return 0;
+    }
+}
+
+static void *rawAllocate(size_t size) {
+    return __libc_malloc(size);
+}
+
+static void *rawAllocateAligned(size_t size, size_t alignment) {
+    return __libc_memalign(alignment, size);
+}
+
+static void rawFreeAligned(void *ptr) {
+    std::free(ptr);
+}
+
+#elif defined(_WIN32)
+
+#include <malloc.h>
+
+static void *rawAllocate(size_t size) {
+    return std::malloc(size);
+}
+
+static void *rawAllocateAligned(size_t size, size_t alignment) {
+    return _aligned_malloc(size, alignment);
+}
+
+static void rawFreeAligned(void *ptr) {
+    _aligned_free(ptr);
+}
+
+#else
+
+static void *rawAllocate(size_t size) {
+    return std::malloc(size);
+}
+
+static void *rawAllocateAligned(size_t size, size_t alignment) {
+    void *result = nullptr;
+    return (posix_memalign(&result, alignment, size) == 0) ? result : nullptr;
+}
+
+static void rawFreeAligned(void *ptr) {
+    std::free(ptr);
+}
+
+#endif
+
+static void *hookedNew(size_t size) {
+    onAllocation(size);
+    return rawAllocate((size > 0) ? size : 1);
+}
+
+void *operator new(size_t size) {
+    if (auto ptr = hookedNew(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    if (auto ptr = hookedNew(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return hookedNew(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return hookedNew(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+static void *hookedNewAligned(size_t size, std::align_val_t alignment) {
+    onAllocation(size);
+    return rawAllocateAligned((size > 0) ? size : 1, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    if (auto ptr = hookedNewAligned(size, alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    if (auto ptr = hookedNewAligned(size, alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return hookedNewAligned(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return hookedNewAligned(size, alignment);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    rawFreeAligned(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    rawFreeAligned(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    rawFreeAligned(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+    rawFreeAligned(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    rawFreeAligned(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    rawFreeAligned(ptr);
+}
+
+
+AllocationDetector::Scope::Scope() {
+    scopeDepth++;
+}
+
+AllocationDetector::Scope::~Scope() {
+    scopeDepth--;
+}
+
+uint64_t AllocationDetector::getNumDetectedAllocations() {
+    return numDetectedAllocations;
+}
+
+#else
+
+uint64_t AllocationDetector::getNumDetectedAllocations() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,63 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Detects heap allocations made by the audio thread. Only active in builds with `LIBREARP_DETECT_ALLOCATIONS`
+ * enabled, which replace the global `operator new` (and `malloc` and the aligned allocation functions on glibc) with
+ * hooked versions; in all other builds, this does nothing at all.
+ *
+ * Each allocation made inside of a `Scope` is counted, reported to the standard error output and asserted on.
+ */
+class AllocationDetector {
+public:
+
+    /**
+     * Marks the current thread as the audio thread for the lifetime of the scope.
+     */
+    class Scope {
+    public:
+#if LIBREARP_DETECT_ALLOCATIONS
+        Scope();
+        ~Scope();
+#else
+        Scope() = default;
+#endif
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    /**
+     * @return whether allocation detection is compiled in
+     */
+    static constexpr bool isEnabled() {
+#if LIBREARP_DETECT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @return the total number of allocations detected inside of scopes, in all threads
+     */
+    static uint64_t getNumDetectedAllocations();
+};
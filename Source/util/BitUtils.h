@@ -0,0 +1,70 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+/**
+ * Bit manipulation helpers, mapped to compiler intrinsics.
+ */
+namespace BitUtils {
+
+    /**
+     * @return the index of the lowest set bit in the specified word, which must not be zero
+     */
+    inline int countTrailingZeros(uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<int>(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<uint32_t>(word))) {
+            return static_cast<int>(index);
+        }
+        _BitScanForward(&index, static_cast<uint32_t>(word >> 32));
+        return static_cast<int>(index) + 32;
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    /**
+     * @return the index of the highest set bit in the specified word, which must not be zero
+     */
+    inline int highestSetBit(uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, word);
+        return static_cast<int>(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, static_cast<uint32_t>(word >> 32))) {
+            return static_cast<int>(index) + 32;
+        }
+        _BitScanReverse(&index, static_cast<uint32_t>(word));
+        return static_cast<int>(index);
+#else
+        return 63 - __builtin_clzll(word);
+#endif
+    }
+}
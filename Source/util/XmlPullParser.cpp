@@ -0,0 +1,350 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <cstdint>
+#include <cstring>
+
+#include "XmlPullParser.h"
+
+namespace {
+    bool isWhitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    void appendUtf8(std::string &out, uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            out.push_back(static_cast<char>(codePoint));
+        } else if (codePoint < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (codePoint >> 6)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        } else if (codePoint < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (codePoint >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xf0 | (codePoint >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        }
+    }
+}
+
+XmlPullParser::XmlPullParser(juce::InputStream &input) : input(input), chunk(CHUNK_SIZE) {}
+
+
+XmlPullParser::Event XmlPullParser::next() {
+    if (this->finished) {
+        return this->finalEvent;
+    }
+
+    if (this->closePending) {
+        this->closePending = false;
+        this->depth--;
+    }
+
+    if (this->pendingEnd) {
+        this->pendingEnd = false;
+        this->closePending = true;
+        return Event::END_ELEMENT;
+    }
+
+    while (true) {
+        auto c = read();
+        if (c < 0) {
+            return finish((this->hadRoot && this->depth == 0) ? Event::END_OF_DOCUMENT : Event::ERROR);
+        }
+        if (c != '<') {
+            continue; // Text is not reported
+        }
+
+        c = read();
+        switch (c) {
+            case -1:
+                return finish(Event::ERROR);
+            case '?':
+                if (!skipPast("?>")) {
+                    return finish(Event::ERROR);
+                }
+                break;
+            case '!':
+                if (!skipMarkupDeclaration()) {
+                    return finish(Event::ERROR);
+                }
+                break;
+            case '/':
+                return readEndTag();
+            default:
+                return readStartTag(c);
+        }
+    }
+}
+
+const std::string &XmlPullParser::getName() const {
+    static const std::string NO_NAME;
+    return (this->depth > 0) ? this->openElements[static_cast<size_t>(this->depth - 1)] : NO_NAME;
+}
+
+int XmlPullParser::getDepth() const {
+    return this->depth;
+}
+
+const char *XmlPullParser::getAttribute(const char *attributeName) const {
+    for (auto &attribute : this->attributes) {
+        if (std::strcmp(this->attributeData.data() + attribute.nameOffset, attributeName) == 0) {
+            return this->attributeData.data() + attribute.valueOffset;
+        }
+    }
+    return nullptr;
+}
+
+
+bool XmlPullParser::fillChunk() {
+    auto numRead = this->input.read(this->chunk.data(), static_cast<int>(this->chunk.size()));
+    if (numRead <= 0) {
+        return false;
+    }
+    this->chunkPos = 0;
+    this->chunkSize = static_cast<size_t>(numRead);
+    return true;
+}
+
+bool XmlPullParser::skipPast(const char *terminator) {
+    // Terminators are at most three characters long; the last ones read are compared to it
+    auto length = std::strlen(terminator);
+    char window[3] = {};
+    size_t numRead = 0;
+    while (true) {
+        auto c = read();
+        if (c < 0) {
+            return false;
+        }
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = static_cast<char>(c);
+        numRead++;
+        if (numRead >= length && std::memcmp(window + 3 - length, terminator, length) == 0) {
+            return true;
+        }
+    }
+}
+
+bool XmlPullParser::skipMarkupDeclaration() {
+    auto c = read();
+    if (c == '-') {
+        return read() == '-' && skipPast("-->");
+    }
+    if (c == '[') {
+        return skipPast("]]>"); // CDATA section
+    }
+
+    // Doctype declaration, possibly with an internal subset in brackets
+    int bracketDepth = 0;
+    int quote = 0;
+    while (c >= 0) {
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '[') {
+            bracketDepth++;
+        } else if (c == ']') {
+            bracketDepth--;
+        } else if (c == '>' && bracketDepth <= 0) {
+            return true;
+        }
+        c = read();
+    }
+    return false;
+}
+
+XmlPullParser::Event XmlPullParser::readStartTag(int first) {
+    if (this->hadRoot && this->depth == 0) {
+        return finish(Event::ERROR); // Only a single root element is allowed
+    }
+
+    this->tag.clear();
+    auto c = first;
+    int quote = 0;
+    while (quote != 0 || c != '>') {
+        if (c < 0) {
+            return finish(Event::ERROR);
+        }
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        }
+        this->tag.push_back(static_cast<char>(c));
+        c = read();
+    }
+
+    auto end = this->tag.size();
+    auto isEmptyElement = end > 0 && this->tag[end - 1] == '/';
+    if (isEmptyElement) {
+        end--;
+    }
+
+    size_t nameEnd = 0;
+    while (nameEnd < end && !isWhitespace(this->tag[nameEnd])) {
+        nameEnd++;
+    }
+    if (nameEnd == 0 || !parseAttributes(nameEnd, end)) {
+        return finish(Event::ERROR);
+    }
+
+    if (this->openElements.size() <= static_cast<size_t>(this->depth)) {
+        this->openElements.emplace_back();
+    }
+    this->openElements[static_cast<size_t>(this->depth)].assign(this->tag, 0, nameEnd);
+    this->depth++;
+    this->hadRoot = true;
+    this->pendingEnd = isEmptyElement;
+    return Event::START_ELEMENT;
+}
+
+XmlPullParser::Event XmlPullParser::readEndTag() {
+    this->tag.clear();
+    auto c = read();
+    while (c != '>') {
+        if (c < 0) {
+            return finish(Event::ERROR);
+        }
+        this->tag.push_back(static_cast<char>(c));
+        c = read();
+    }
+    while (!this->tag.empty() && isWhitespace(this->tag.back())) {
+        this->tag.pop_back();
+    }
+
+    if (this->depth == 0 || this->tag != getName()) {
+        return finish(Event::ERROR); // Mismatched end tag
+    }
+
+    this->attributes.clear();
+    this->closePending = true;
+    return Event::END_ELEMENT;
+}
+
+bool XmlPullParser::parseAttributes(size_t from, size_t to) {
+    this->attributes.clear();
+    this->attributeData.clear();
+
+    auto pos = from;
+    while (true) {
+        while (pos < to && isWhitespace(this->tag[pos])) {
+            pos++;
+        }
+        if (pos == to) {
+            return true;
+        }
+
+        auto nameStart = pos;
+        while (pos < to && this->tag[pos] != '=' && !isWhitespace(this->tag[pos])) {
+            pos++;
+        }
+        auto nameEnd = pos;
+        while (pos < to && isWhitespace(this->tag[pos])) {
+            pos++;
+        }
+        if (nameEnd == nameStart || pos == to || this->tag[pos] != '=') {
+            return false;
+        }
+        pos++;
+        while (pos < to && isWhitespace(this->tag[pos])) {
+            pos++;
+        }
+        if (pos == to || (this->tag[pos] != '"' && this->tag[pos] != '\'')) {
+            return false;
+        }
+        auto quote = this->tag[pos++];
+        auto valueStart = pos;
+        while (pos < to && this->tag[pos] != quote) {
+            pos++;
+        }
+        if (pos == to) {
+            return false;
+        }
+
+        Attribute attribute {};
+        attribute.nameOffset = this->attributeData.size();
+        this->attributeData.append(this->tag, nameStart, nameEnd - nameStart);
+        this->attributeData.push_back('\0');
+        attribute.valueOffset = this->attributeData.size();
+        if (!appendDecoded(valueStart, pos)) {
+            return false;
+        }
+        this->attributeData.push_back('\0');
+        this->attributes.push_back(attribute);
+        pos++;
+    }
+}
+
+bool XmlPullParser::appendDecoded(size_t from, size_t to) {
+    auto pos = from;
+    while (pos < to) {
+        auto c = this->tag[pos++];
+        if (c != '&') {
+            this->attributeData.push_back(c);
+            continue;
+        }
+
+        auto entityEnd = this->tag.find(';', pos);
+        if (entityEnd == std::string::npos || entityEnd >= to) {
+            return false;
+        }
+        auto entity = this->tag.data() + pos;
+        auto length = entityEnd - pos;
+        pos = entityEnd + 1;
+
+        if (length == 2 && std::strncmp(entity, "lt", 2) == 0) {
+            this->attributeData.push_back('<');
+        } else if (length == 2 && std::strncmp(entity, "gt", 2) == 0) {
+            this->attributeData.push_back('>');
+        } else if (length == 3 && std::strncmp(entity, "amp", 3) == 0) {
+            this->attributeData.push_back('&');
+        } else if (length == 4 && std::strncmp(entity, "quot", 4) == 0) {
+            this->attributeData.push_back('"');
+        } else if (length == 4 && std::strncmp(entity, "apos", 4) == 0) {
+            this->attributeData.push_back('\'');
+        } else if (length >= 2 && entity[0] == '#') {
+            auto isHex = entity[1] == 'x' || entity[1] == 'X';
+            auto digits = juce::String(entity + (isHex ? 2 : 1), length - (isHex ? 2 : 1));
+            if (digits.isEmpty()) {
+                return false;
+            }
+            auto codePoint = isHex ? digits.getHexValue32() : digits.getIntValue();
+            if (codePoint <= 0 || codePoint > 0x10ffff) {
+                return false;
+            }
+            appendUtf8(this->attributeData, static_cast<uint32_t>(codePoint));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+XmlPullParser::Event XmlPullParser::finish(Event event) {
+    this->finished = true;
+    this->finalEvent = event;
+    return event;
+}
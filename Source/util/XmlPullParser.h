@@ -0,0 +1,124 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <juce_core/juce_core.h>
+
+/**
+ * A minimal pull parser for XML documents read from a stream. The document is read in fixed-size chunks and reported
+ * element by element, so that large documents can be read without building a tree of them in memory.
+ *
+ * Only elements and their attributes are reported; text, comments, CDATA sections, processing instructions and
+ * doctype declarations are skipped. Entity references in attribute values are decoded (the predefined ones and
+ * character references only). Empty-element tags are reported as a start followed by an end.
+ */
+class XmlPullParser {
+public:
+
+    enum class Event {
+        START_ELEMENT,
+        END_ELEMENT,
+        END_OF_DOCUMENT,
+        ERROR
+    };
+
+    /**
+     * @param input the stream to read the document from; must outlive the parser
+     */
+    explicit XmlPullParser(juce::InputStream &input);
+
+    /**
+     * Reads up to the next start or end of an element.
+     *
+     * @return the event that has been read; once the end of the document or an error has been reached, it is returned
+     * again by every subsequent call
+     */
+    Event next();
+
+    /**
+     * @return the name of the current element
+     */
+    const std::string &getName() const;
+
+    /**
+     * @return the nesting depth of the current element; the root element is at depth 1
+     */
+    int getDepth() const;
+
+    /**
+     * Gets the value of an attribute of the current start element.
+     *
+     * @param name the name of the attribute
+     * @return the decoded value of the attribute, or `nullptr` if the element has no such attribute
+     */
+    const char *getAttribute(const char *name) const;
+
+private:
+
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+    /**
+     * Offsets of the name and the value of an attribute in `attributeData`, each terminated by a null character.
+     */
+    struct Attribute {
+        size_t nameOffset;
+        size_t valueOffset;
+    };
+
+    juce::InputStream &input;
+    std::vector<char> chunk;
+    size_t chunkPos = 0;
+    size_t chunkSize = 0;
+
+    std::string tag;
+    std::string attributeData;
+    std::vector<Attribute> attributes;
+
+    /**
+     * The names of the currently open elements; strings are reused, so only `depth` of them are valid.
+     */
+    std::vector<std::string> openElements;
+    int depth = 0;
+    bool hadRoot = false;
+    bool pendingEnd = false;
+    bool closePending = false;
+    bool finished = false;
+    Event finalEvent = Event::END_OF_DOCUMENT;
+
+    /**
+     * @return the next character of the document, or -1 at its end
+     */
+    int read() {
+        if (chunkPos == chunkSize && !fillChunk()) {
+            return -1;
+        }
+        return static_cast<unsigned char>(chunk[chunkPos++]);
+    }
+
+    bool fillChunk();
+    bool skipPast(const char *terminator);
+    bool skipMarkupDeclaration();
+    Event readStartTag(int first);
+    Event readEndTag();
+    bool parseAttributes(size_t from, size_t to);
+    bool appendDecoded(size_t from, size_t to);
+    Event finish(Event event);
+};
@@ -0,0 +1,841 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "OfflineHost.h"
+#include "util/AllocationDetector.h"
+
+/*
+ * LibreArpBenchmark - micro-benchmarks of the LibreArp engine.
+ *
+ * Every case is measured on synthetic patterns and inputs, repeating the measured operation until a minimum time has
+ * elapsed. The results are printed as JSON so that they may be compared between builds.
+ *
+ * With `--check`, long simulated sessions are played instead, verifying that the engine's timing does not drift;
+ * incrementally built events are compared with full builds, and patterns read from XML with the ones written.
+ */
+
+static const char *const USAGE =
+        "Usage: LibreArpBenchmark [options]\n"
+        "\n"
+        "Runs micro-benchmarks of the LibreArp engine and prints the results as JSON.\n"
+        "\n"
+        "Options:\n"
+        "  --output=<file>       write the results into a file instead of the standard output\n"
+        "  --filter=<text>       only run the cases whose names contain the specified text\n"
+        "  --min-time=<seconds>  minimum measured time of each case (default: 0.5)\n"
+        "  --quick               only run a reduced set of cases\n"
+        "  --list                list the case names without running them\n"
+        "  --check               verify the timing of long simulated sessions, the results of incremental builds and\n"
+        "                        the reading of XML patterns instead of benchmarking\n";
+
+static const double SAMPLE_RATE = 48000.0;
+static const double BPM = 120.0;
+
+static const std::vector<int> NOTE_COUNTS = { 10, 100, 1000, 10000, 100000 };
+static const std::vector<int> CHORD_SIZES = { 1, 2, 4, 8, 16 };
+static const std::vector<int> BLOCK_SIZES = { 16, 64, 256, 1024, 4096, 8192 };
+
+static const std::vector<int> QUICK_NOTE_COUNTS = { 10, 1000, 100000 };
+static const std::vector<int> QUICK_CHORD_SIZES = { 1, 16 };
+static const std::vector<int> QUICK_BLOCK_SIZES = { 16, 512, 8192 };
+
+static const std::vector<int> LAYER_COUNTS = { 2, 4, 8 };
+static const std::vector<int> QUICK_LAYER_COUNTS = { 4 };
+
+static const double CHECK_SESSION_HOURS = 3.0;
+static const double CHECK_SAMPLE_RATE = 44100.0;
+static const std::vector<int> CHECK_BLOCK_SIZES = { 64, 441, 512, 4096 };
+static const std::vector<int> QUICK_CHECK_BLOCK_SIZES = { 441 };
+static const int CHECK_EDITS = 200;
+
+
+/**
+ * Options of a benchmark run.
+ */
+struct BenchmarkOptions {
+    juce::String filter;
+    double minTime = 0.5;
+    bool quick = false;
+    bool list = false;
+    bool check = false;
+};
+
+/**
+ * A single benchmark case.
+ */
+struct BenchmarkCase {
+    /**
+     * The unique name of the case.
+     */
+    juce::String name;
+
+    /**
+     * The benchmarked operation, e.g. "buildEvents".
+     */
+    juce::String operation;
+
+    /**
+     * The parameters of the case, written into the results.
+     */
+    juce::NamedValueSet parameters;
+
+    /**
+     * Sets the case up and returns the measured function. The measured function is called repeatedly, each call
+     * being one measured iteration.
+     */
+    std::function<std::function<void()>()> setUp;
+};
+
+
+/**
+ * Creates a deterministic synthetic pattern with the specified number of notes. Notes are laid out in sixteenths,
+ * four voices at a time, each lasting an eighth, cycling through the 16 possible input notes.
+ */
+static ArpPattern makePattern(int numNotes) {
+    ArpPattern pattern(ArpPattern::DEFAULT_TIMEBASE);
+    juce::Random random(numNotes);
+
+    const int64_t step = ArpPattern::DEFAULT_TIMEBASE / 4;
+    auto &notes = pattern.getNotes();
+    notes.reserve(static_cast<size_t>(numNotes));
+    for (int i = 0; i < numNotes; i++) {
+        NoteData data;
+        data.noteNumber = i % 16;
+        data.velocity = 0.5 + random.nextDouble() * 0.5;
+        data.pan = random.nextDouble() * 2.0 - 1.0;
+
+        ArpNote note(data);
+        note.startPoint = (i / 4) * step;
+        note.endPoint = note.startPoint + step * 2;
+        notes.push_back(note);
+    }
+
+    auto end = notes.empty() ? int64_t(0) : notes.back().endPoint;
+    pattern.loopStart = 0;
+    pattern.loopEnd = juce::jmax(int64_t(ArpPattern::DEFAULT_TIMEBASE),
+                                 (end + ArpPattern::DEFAULT_TIMEBASE - 1)
+                                         / ArpPattern::DEFAULT_TIMEBASE * ArpPattern::DEFAULT_TIMEBASE);
+    return pattern;
+}
+
+/**
+ * Creates a processor with the specified number of layers, each with a synthetic pattern of the specified number of
+ * notes.
+ */
+static std::unique_ptr<LibreArp> makeProcessor(int numNotes, int numLayers = 1) {
+    auto processor = std::make_unique<LibreArp>(false);
+    processor->setNonPlayingModeOverride(NonPlayingMode::Value::SILENCE);
+    auto pattern = makePattern(numNotes);
+    processor->setPattern(pattern);
+    for (int i = 1; i < numLayers; i++) {
+        processor->addLayer();
+        processor->setPattern(pattern);
+    }
+    return processor;
+}
+
+
+static void addProcessMidiCase(std::vector<BenchmarkCase> &cases, int numNotes, int chordSize, int blockSize,
+                               int numLayers = 1) {
+    BenchmarkCase c;
+    c.name = "processMidi/notes:" + juce::String(numNotes)
+            + "/chord:" + juce::String(chordSize)
+            + "/block:" + juce::String(blockSize);
+    if (numLayers > 1) {
+        c.name += "/layers:" + juce::String(numLayers);
+    }
+    c.operation = "processMidi";
+    c.parameters.set("notes", numNotes);
+    c.parameters.set("chordSize", chordSize);
+    c.parameters.set("blockSize", blockSize);
+    c.parameters.set("layers", numLayers);
+    c.setUp = [numNotes, chordSize, blockSize, numLayers]() -> std::function<void()> {
+        /**
+         * Owns the processor and its host, destroying the host first.
+         */
+        struct Fixture {
+            std::unique_ptr<LibreArp> processor;
+            std::unique_ptr<OfflineHost> host;
+            juce::MidiBuffer midi;
+        };
+
+        auto fixture = std::make_shared<Fixture>();
+        fixture->processor = makeProcessor(numNotes, numLayers);
+        fixture->host = std::make_unique<OfflineHost>(*fixture->processor, SAMPLE_RATE, blockSize);
+        fixture->host->setTempo(BPM);
+
+        // Hold the chord from the first block on
+        for (int i = 0; i < chordSize; i++) {
+            fixture->midi.addEvent(juce::MidiMessage::noteOn(1, 48 + i * 2, juce::uint8(100)), 0);
+        }
+        fixture->host->processBlock(fixture->midi);
+
+        return [fixture]() {
+            fixture->midi.clear();
+            fixture->host->processBlock(fixture->midi);
+        };
+    };
+    cases.push_back(c);
+}
+
+static void addBuildEventsCase(std::vector<BenchmarkCase> &cases, int numNotes) {
+    BenchmarkCase c;
+    c.name = "buildEvents/notes:" + juce::String(numNotes);
+    c.operation = "buildEvents";
+    c.parameters.set("notes", numNotes);
+    c.setUp = [numNotes]() -> std::function<void()> {
+        auto pattern = std::make_shared<ArpPattern>();
+        *pattern = makePattern(numNotes);
+        return [pattern]() {
+            auto events = pattern->buildEvents();
+            juce::ignoreUnused(events);
+        };
+    };
+    cases.push_back(c);
+}
+
+static void addPatchEventsCase(std::vector<BenchmarkCase> &cases, int numNotes, int numChanged) {
+    BenchmarkCase c;
+    c.name = "patchEvents/notes:" + juce::String(numNotes) + "/changed:" + juce::String(numChanged);
+    c.operation = "patchEvents";
+    c.parameters.set("notes", numNotes);
+    c.parameters.set("changed", numChanged);
+    c.setUp = [numNotes, numChanged]() -> std::function<void()> {
+        auto pattern = std::make_shared<ArpPattern>();
+        *pattern = makePattern(numNotes);
+        auto previous = std::make_shared<ArpBuiltEvents>(pattern->buildEvents());
+
+        // Simulates dragging a selection back and forth by a sixteenth
+        std::vector<size_t> changedNotes;
+        for (int i = 0; i < numChanged && i < numNotes; i++) {
+            changedNotes.push_back(static_cast<size_t>(i));
+        }
+        auto direction = std::make_shared<int64_t>(ArpPattern::DEFAULT_TIMEBASE / 4);
+
+        return [pattern, previous, changedNotes, direction]() {
+            auto &notes = pattern->getNotes();
+            for (auto index : changedNotes) {
+                notes[index].startPoint += *direction;
+                notes[index].endPoint += *direction;
+            }
+            *direction = -*direction;
+            *previous = pattern->buildEvents(*previous, changedNotes);
+        };
+    };
+    cases.push_back(c);
+}
+
+static void addGetStateCase(std::vector<BenchmarkCase> &cases, int numNotes, bool cached) {
+    BenchmarkCase c;
+    c.name = "getStateInformation/notes:" + juce::String(numNotes);
+    if (cached) {
+        c.name += "/cached";
+    }
+    c.operation = "getStateInformation";
+    c.parameters.set("notes", numNotes);
+    c.parameters.set("cached", cached);
+    c.setUp = [numNotes, cached]() -> std::function<void()> {
+        auto processor = std::shared_ptr<LibreArp>(makeProcessor(numNotes));
+        auto iteration = std::make_shared<int>(0);
+        return [processor, iteration, cached]() {
+            if (!cached) {
+                // Change the state, so that it has to be serialized again
+                processor->setLoopReset((++*iteration) % 2);
+            }
+            juce::MemoryBlock state;
+            processor->getStateInformation(state);
+        };
+    };
+    cases.push_back(c);
+}
+
+static void addSetStateCase(std::vector<BenchmarkCase> &cases, int numNotes) {
+    BenchmarkCase c;
+    c.name = "setStateInformation/notes:" + juce::String(numNotes);
+    c.operation = "setStateInformation";
+    c.parameters.set("notes", numNotes);
+    c.setUp = [numNotes]() -> std::function<void()> {
+        auto processor = std::shared_ptr<LibreArp>(makeProcessor(numNotes));
+        auto state = std::make_shared<juce::MemoryBlock>();
+        processor->getStateInformation(*state);
+        return [processor, state]() {
+            processor->setStateInformation(state->getData(), static_cast<int>(state->getSize()));
+        };
+    };
+    cases.push_back(c);
+}
+
+static void addToFileCase(std::vector<BenchmarkCase> &cases, int numNotes) {
+    BenchmarkCase c;
+    c.name = "toFile/notes:" + juce::String(numNotes);
+    c.operation = "toFile";
+    c.parameters.set("notes", numNotes);
+    c.setUp = [numNotes]() -> std::function<void()> {
+        auto file = std::make_shared<juce::TemporaryFile>(".lapreset");
+        auto pattern = std::make_shared<ArpPattern>();
+        *pattern = makePattern(numNotes);
+        return [file, pattern]() {
+            pattern->toFile(file->getFile());
+        };
+    };
+    cases.push_back(c);
+}
+
+static void addFromFileCase(std::vector<BenchmarkCase> &cases, int numNotes) {
+    BenchmarkCase c;
+    c.name = "fromFile/notes:" + juce::String(numNotes);
+    c.operation = "fromFile";
+    c.parameters.set("notes", numNotes);
+    c.setUp = [numNotes]() -> std::function<void()> {
+        auto file = std::make_shared<juce::TemporaryFile>(".lapreset");
+        makePattern(numNotes).toFile(file->getFile());
+        return [file]() {
+            auto pattern = ArpPattern::fromFile(file->getFile());
+            juce::ignoreUnused(pattern);
+        };
+    };
+    cases.push_back(c);
+}
+
+static std::vector<BenchmarkCase> makeCases(bool quick) {
+    auto &noteCounts = (quick) ? QUICK_NOTE_COUNTS : NOTE_COUNTS;
+    auto &chordSizes = (quick) ? QUICK_CHORD_SIZES : CHORD_SIZES;
+    auto &blockSizes = (quick) ? QUICK_BLOCK_SIZES : BLOCK_SIZES;
+    auto &layerCounts = (quick) ? QUICK_LAYER_COUNTS : LAYER_COUNTS;
+
+    std::vector<BenchmarkCase> cases;
+    for (auto numNotes : noteCounts) {
+        for (auto chordSize : chordSizes) {
+            for (auto blockSize : blockSizes) {
+                addProcessMidiCase(cases, numNotes, chordSize, blockSize);
+            }
+        }
+    }
+    for (auto numLayers : layerCounts) {
+        addProcessMidiCase(cases, 1000, 4, 512, numLayers);
+    }
+    for (auto numNotes : noteCounts) {
+        addBuildEventsCase(cases, numNotes);
+        addPatchEventsCase(cases, numNotes, 16);
+    }
+    for (auto numNotes : noteCounts) {
+        addGetStateCase(cases, numNotes, false);
+        addGetStateCase(cases, numNotes, true);
+    }
+    for (auto numNotes : noteCounts) {
+        addSetStateCase(cases, numNotes);
+    }
+    for (auto numNotes : noteCounts) {
+        addToFileCase(cases, numNotes);
+        addFromFileCase(cases, numNotes);
+    }
+    return cases;
+}
+
+
+/**
+ * Plays a simulated session with a pattern of a note on every pulse and verifies that every pulse is played exactly
+ * once, each within one sample of its exact time.
+ *
+ * @return an error message, or an empty string if the session played correctly
+ */
+static juce::String checkSessionTiming(double hours, double sampleRate, int blockSize) {
+    const int timebase = ArpPattern::DEFAULT_TIMEBASE;
+    ArpPattern pattern(timebase);
+    auto &notes = pattern.getNotes();
+    for (int64_t i = 0; i < timebase * 4; i++) {
+        ArpNote note;
+        note.startPoint = i;
+        note.endPoint = i + 1;
+        notes.push_back(note);
+    }
+    pattern.loopStart = 0;
+    pattern.loopEnd = timebase * 4;
+
+    LibreArp processor(false);
+    processor.setNonPlayingModeOverride(NonPlayingMode::Value::SILENCE);
+    processor.setSwing(0.0f);
+    processor.setPattern(pattern);
+
+    OfflineHost host(processor, sampleRate, blockSize);
+    host.setTempo(BPM);
+
+    const double samplesPerPulse = host.ppqToSamples(1.0) / timebase;
+    const auto sessionLength = static_cast<int64_t>(hours * 3600.0 * sampleRate);
+
+    juce::MidiBuffer midi;
+    midi.addEvent(juce::MidiMessage::noteOn(1, 60, juce::uint8(100)), 0);
+
+    int64_t numPulses = 0;
+    while (host.getPosition() < sessionLength) {
+        auto blockStart = host.getPosition();
+        host.processBlock(midi);
+
+        for (const auto metadata : midi) {
+            auto message = metadata.getMessage();
+            if (!message.isNoteOn()) {
+                continue;
+            }
+
+            auto exactTime = static_cast<double>(numPulses) * samplesPerPulse;
+            auto time = static_cast<double>(blockStart + metadata.samplePosition);
+            if (std::abs(time - exactTime) > 1.0) {
+                return "Pulse " + juce::String(numPulses) + " played at sample " + juce::String(time)
+                        + ", expected at " + juce::String(exactTime);
+            }
+            numPulses++;
+        }
+        midi.clear();
+    }
+
+    // Pulses within a sample of the end may fall on either side of it
+    auto end = static_cast<double>(host.getPosition());
+    auto minPulses = static_cast<int64_t>(std::ceil((end - 1.0) / samplesPerPulse));
+    auto maxPulses = static_cast<int64_t>(std::ceil((end + 1.0) / samplesPerPulse));
+    if (numPulses < minPulses || numPulses > maxPulses) {
+        return "Played " + juce::String(numPulses) + " pulses, expected " + juce::String(minPulses);
+    }
+    return {};
+}
+
+/**
+ * Compares two built events, including the data of notes without events.
+ */
+static bool isSameEvents(const ArpBuiltEvents &a, const ArpBuiltEvents &b) {
+    if (a.timebase != b.timebase || a.loopStart != b.loopStart || a.loopLength != b.loopLength
+            || a.events.size() != b.events.size() || a.ons != b.ons || a.offs != b.offs
+            || a.data.noteNumbers != b.data.noteNumbers || a.data.velocities != b.data.velocities
+            || a.data.pans != b.data.pans || a.onTimes != b.onTimes || a.offTimes != b.offTimes) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.events.size(); i++) {
+        auto &x = a.events[i];
+        auto &y = b.events[i];
+        if (x.time != y.time || x.onsOffset != y.onsOffset || x.onsCount != y.onsCount
+                || x.offsOffset != y.offsOffset || x.offsCount != y.offsCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Edits a synthetic pattern in random ways - moving and resizing notes, also past and up to the loop end, changing
+ * their data and appending notes - and verifies that patching the events after each edit gives the same events as a
+ * full build.
+ *
+ * @return an error message, or an empty string if all the patched events were correct
+ */
+static juce::String checkPatchedEvents(int numNotes, int numEdits) {
+    auto pattern = makePattern(numNotes);
+    auto &notes = pattern.getNotes();
+    juce::Random random(numNotes);
+
+    auto previous = pattern.buildEvents();
+    for (int edit = 0; edit < numEdits; edit++) {
+        auto loopLength = pattern.loopEnd - pattern.loopStart;
+        std::vector<size_t> changedNotes;
+        auto numChanged = random.nextInt(8);
+        for (int i = 0; i < numChanged && !notes.empty(); i++) {
+            auto index = static_cast<size_t>(random.nextInt(static_cast<int>(notes.size())));
+            auto &note = notes[index];
+            auto length = note.endPoint - note.startPoint;
+            note.startPoint = pattern.loopStart + random.nextInt(static_cast<int>(loopLength) + 1);
+            note.endPoint = (random.nextInt(4) == 0)
+                    ? pattern.loopEnd
+                    : note.startPoint + juce::jmax(int64_t(1), length + random.nextInt(9) - 4);
+            note.data.noteNumber = random.nextInt(16);
+            note.data.velocity = random.nextDouble();
+            changedNotes.push_back(index);
+        }
+
+        auto numAppended = random.nextInt(3);
+        for (int i = 0; i < numAppended; i++) {
+            ArpNote note;
+            note.startPoint = pattern.loopStart + random.nextInt(static_cast<int>(loopLength));
+            note.endPoint = note.startPoint + 1 + random.nextInt(ArpPattern::DEFAULT_TIMEBASE);
+            notes.push_back(note);
+        }
+
+        auto patched = pattern.buildEvents(previous, changedNotes);
+        if (!isSameEvents(patched, pattern.buildEvents())) {
+            return "Patched events differ from a full build after edit " + juce::String(edit);
+        }
+        previous = std::move(patched);
+    }
+    return {};
+}
+
+/**
+ * Compares two patterns. Velocities and pans may differ by rounding, since they are written as text.
+ */
+static bool isSamePattern(ArpPattern &a, ArpPattern &b) {
+    auto &notesA = a.getNotes();
+    auto &notesB = b.getNotes();
+    if (a.getTimebase() != b.getTimebase() || a.loopStart != b.loopStart || a.loopEnd != b.loopEnd
+            || notesA.size() != notesB.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < notesA.size(); i++) {
+        auto &x = notesA[i];
+        auto &y = notesB[i];
+        if (x.startPoint != y.startPoint || x.endPoint != y.endPoint || x.data.noteNumber != y.data.noteNumber
+                || std::abs(x.data.velocity - y.data.velocity) > 1e-9 || std::abs(x.data.pan - y.data.pan) > 1e-9) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads a pattern from the specified XML document the way value trees are loaded, through a parsed juce::XmlElement.
+ */
+static ArpPattern readXmlThroughValueTree(const juce::String &document) {
+    auto xml = juce::XmlDocument::parse(document);
+    if (xml == nullptr) {
+        return ArpPattern();
+    }
+    auto tree = juce::ValueTree::fromXml(*xml);
+    return ArpPattern::fromValueTree(tree);
+}
+
+/**
+ * Reads a pattern from the specified XML document with `ArpPattern::fromXmlStream()`.
+ */
+static ArpPattern readXmlStream(const juce::String &document, bool &outSuccess) {
+    juce::MemoryInputStream in(document.toRawUTF8(), document.getNumBytesAsUTF8(), false);
+    return ArpPattern::fromXmlStream(in, &outSuccess);
+}
+
+/**
+ * Writes a synthetic pattern as XML, both as a stream and through a value tree, and verifies that reading each of the
+ * documents back, both as a stream and through a value tree, gives the same pattern.
+ *
+ * @return an error message, or an empty string if all the patterns read back were the same
+ */
+static juce::String checkXmlRoundTrip(int numNotes) {
+    auto pattern = makePattern(numNotes);
+    pattern.loopStart = ArpPattern::DEFAULT_TIMEBASE;
+    if (!pattern.getNotes().empty()) {
+        pattern.getNotes().front().data.noteNumber = -3;
+    }
+
+    juce::MemoryOutputStream out;
+    pattern.toXmlStream(out);
+    auto streamedDocument = out.toString();
+    auto treeDocument = pattern.toValueTree().toXmlString();
+
+    auto checkDocument = [&pattern](const juce::String &document, const juce::String &writer) -> juce::String {
+        bool success;
+        auto streamed = readXmlStream(document, success);
+        if (!success || !isSamePattern(pattern, streamed)) {
+            return "The pattern written by " + writer + " differs when read by fromXmlStream()";
+        }
+
+        auto parsed = readXmlThroughValueTree(document);
+        if (!isSamePattern(pattern, parsed)) {
+            return "The pattern written by " + writer + " differs when read through a value tree";
+        }
+        return {};
+    };
+
+    auto error = checkDocument(streamedDocument, "toXmlStream()");
+    if (error.isEmpty()) {
+        error = checkDocument(treeDocument, "toValueTree()");
+    }
+    return error;
+}
+
+/**
+ * Verifies that `ArpPattern::fromXmlStream()` reads documents using less common XML syntax the same way as value trees
+ * do, and that it rejects malformed and truncated documents with an empty pattern.
+ *
+ * @return an error message, or an empty string if all the documents were read as expected
+ */
+static juce::String checkXmlDocuments() {
+    // Each document is paired with a plain equivalent, if it contains text, which value trees do not support
+    const std::pair<const char *, const char *> wellFormed[] = {
+        {
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n<!DOCTYPE pattern>\r\n<!-- A comment -->\r\n"
+            "<pattern timebase='48' loopStart = \"0\" loopEnd=\"192\"><?app data?>\r\n"
+            "  <notes><!-- <note startPoint=\"1\" endPoint=\"2\"/> -->\r\n"
+            "    <note startPoint=\"0\" endPoint=\"&#52;&#x38;\">"
+            "<noteData noteNumber=\"2\" velocity=\"0.5\" pan=\"-0.25\"/></note>\r\n"
+            "    <![CDATA[<note startPoint=\"5\" endPoint=\"6\"/>]]>Text &amp; more text\r\n"
+            "    <note startPoint=\"48\" endPoint=\"96\"/>\r\n"
+            "  </notes>\r\n"
+            "</pattern>\r\n",
+
+            "<pattern timebase=\"48\" loopStart=\"0\" loopEnd=\"192\"><notes>"
+            "<note startPoint=\"0\" endPoint=\"48\"><noteData noteNumber=\"2\" velocity=\"0.5\" pan=\"-0.25\"/></note>"
+            "<note startPoint=\"48\" endPoint=\"96\"/>"
+            "</notes></pattern>"
+        },
+
+        // Older versions stored the loop length only
+        { "<pattern timebase=\"96\" loopLength=\"384\">"
+          "<notes><note startPoint=\"0\" endPoint=\"96\"/></notes></pattern>",
+          nullptr },
+
+        // Only the first notes element is read
+        { "<pattern><notes><note startPoint=\"0\" endPoint=\"1\"/></notes>"
+          "<notes><note startPoint=\"5\" endPoint=\"6\"/></notes></pattern>",
+          nullptr },
+    };
+
+    for (auto &[document, plain] : wellFormed) {
+        bool success;
+        auto streamed = readXmlStream(document, success);
+        auto parsed = readXmlThroughValueTree((plain != nullptr) ? plain : document);
+        if (!success || !isSamePattern(streamed, parsed)) {
+            return "A well-formed document is read differently than through a value tree:\n" + juce::String(document);
+        }
+    }
+
+    const char *const malformed[] = {
+        "",
+        "pattern",
+        "<pattern",
+        "<pattern></pattern",
+        "<pattern timebase=\"96\"><notes><note startPoint=\"0\" endPoint=\"1\"/></notes>",
+        "<pattern><notes></pattern>",
+        "<pattern timebase=96></pattern>",
+        "<pattern timebase=\"&unknown;\"></pattern>",
+        "<pattern><!-- An unterminated comment </pattern>",
+        "<pattern><notes><![CDATA[ An unterminated section </notes></pattern>",
+        "<pattern><notes><chord/></notes></pattern>",
+        "<notes><note startPoint=\"0\" endPoint=\"1\"/></notes>",
+    };
+
+    for (auto document : malformed) {
+        bool success;
+        auto pattern = readXmlStream(document, success);
+        if (success || !pattern.getNotes().empty()) {
+            return "A malformed document is not rejected:\n" + juce::String(document);
+        }
+    }
+
+    // Every truncation of a document is rejected, up to the end of its root element
+    auto pattern = makePattern(16);
+    juce::MemoryOutputStream out;
+    pattern.toXmlStream(out);
+    auto document = out.toString();
+    auto rootEnd = document.lastIndexOf("</pattern>") + static_cast<int>(std::strlen("</pattern>"));
+    for (int length = 0; length < rootEnd; length++) {
+        bool success;
+        auto truncated = readXmlStream(document.substring(0, length), success);
+        if (success || !truncated.getNotes().empty()) {
+            return "A document truncated to " + juce::String(length) + " characters is not rejected";
+        }
+    }
+    return {};
+}
+
+/**
+ * Runs the specified check, printing its name and its error, if any.
+ *
+ * @return whether the check passed
+ */
+static bool runCheck(const juce::String &name, const std::function<juce::String()> &check) {
+    std::cerr << name << std::endl;
+
+    auto error = check();
+    if (error.isNotEmpty()) {
+        std::cerr << "  FAILED: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Runs the timing and consistency checks.
+ *
+ * @return whether all the checks passed
+ */
+static bool runChecks(bool quick) {
+    bool passed = true;
+    for (auto blockSize : (quick ? QUICK_CHECK_BLOCK_SIZES : CHECK_BLOCK_SIZES)) {
+        auto name = "sessionTiming/hours:" + juce::String(CHECK_SESSION_HOURS)
+                + "/sampleRate:" + juce::String(CHECK_SAMPLE_RATE)
+                + "/block:" + juce::String(blockSize);
+        passed &= runCheck(name, [blockSize]() {
+            return checkSessionTiming(CHECK_SESSION_HOURS, CHECK_SAMPLE_RATE, blockSize);
+        });
+    }
+
+    for (auto numNotes : (quick ? QUICK_NOTE_COUNTS : NOTE_COUNTS)) {
+        auto name = "patchedEvents/notes:" + juce::String(numNotes) + "/edits:" + juce::String(CHECK_EDITS);
+        passed &= runCheck(name, [numNotes]() { return checkPatchedEvents(numNotes, CHECK_EDITS); });
+    }
+
+    for (auto numNotes : (quick ? QUICK_NOTE_COUNTS : NOTE_COUNTS)) {
+        auto name = "xmlRoundTrip/notes:" + juce::String(numNotes);
+        passed &= runCheck(name, [numNotes]() { return checkXmlRoundTrip(numNotes); });
+    }
+
+    passed &= runCheck("xmlDocuments", checkXmlDocuments);
+    return passed;
+}
+
+
+/**
+ * Runs the specified case and returns its results as a JSON object.
+ */
+static juce::var runCase(const BenchmarkCase &benchmarkCase, double minTime) {
+    using Clock = std::chrono::steady_clock;
+    const size_t minIterations = 5;
+    const int warmupIterations = 2;
+
+    auto function = benchmarkCase.setUp();
+    for (int i = 0; i < warmupIterations; i++) {
+        function();
+    }
+
+    std::vector<double> times;
+    auto allocationsBefore = AllocationDetector::getNumDetectedAllocations();
+    auto startTime = Clock::now();
+    auto minDuration = std::chrono::duration<double>(minTime);
+    while (times.size() < minIterations || Clock::now() - startTime < minDuration) {
+        auto iterationStart = Clock::now();
+        function();
+        auto iterationEnd = Clock::now();
+        times.push_back(std::chrono::duration<double, std::nano>(iterationEnd - iterationStart).count());
+    }
+
+    auto numAllocations = AllocationDetector::getNumDetectedAllocations() - allocationsBefore;
+
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (auto time : times) {
+        total += time;
+    }
+    auto percentile = [&](double p) {
+        auto index = static_cast<size_t>(std::ceil(p * static_cast<double>(times.size()))) - 1;
+        return times[juce::jlimit(size_t(0), times.size() - 1, index)];
+    };
+
+    auto parameters = new juce::DynamicObject();
+    for (auto &parameter : benchmarkCase.parameters) {
+        parameters->setProperty(parameter.name, parameter.value);
+    }
+
+    auto result = new juce::DynamicObject();
+    result->setProperty("name", benchmarkCase.name);
+    result->setProperty("operation", benchmarkCase.operation);
+    result->setProperty("parameters", juce::var(parameters));
+    result->setProperty("iterations", static_cast<int>(times.size()));
+    result->setProperty("meanNs", total / static_cast<double>(times.size()));
+    result->setProperty("medianNs", percentile(0.5));
+    result->setProperty("p99Ns", percentile(0.99));
+    result->setProperty("minNs", times.front());
+    result->setProperty("maxNs", times.back());
+    if (AllocationDetector::isEnabled()) {
+        result->setProperty("audioThreadAllocations", static_cast<juce::int64>(numAllocations));
+    }
+    return juce::var(result);
+}
+
+static int run(juce::ArgumentList args) {
+    if (args.containsOption("--help|-h")) {
+        std::cout << USAGE;
+        return 0;
+    }
+
+    BenchmarkOptions options;
+    options.filter = args.getValueForOption("--filter");
+    options.quick = args.containsOption("--quick");
+    options.list = args.containsOption("--list");
+    options.check = args.containsOption("--check");
+    if (args.containsOption("--min-time")) {
+        options.minTime = args.getValueForOption("--min-time").getDoubleValue();
+        if (options.minTime <= 0.0) {
+            juce::ConsoleApplication::fail("Invalid value of --min-time");
+        }
+    }
+
+    if (options.check) {
+        return runChecks(options.quick) ? 0 : 1;
+    }
+
+    auto cases = makeCases(options.quick);
+    cases.erase(std::remove_if(cases.begin(), cases.end(), [&](const BenchmarkCase &c) {
+        return options.filter.isNotEmpty() && !c.name.contains(options.filter);
+    }), cases.end());
+
+    if (options.list) {
+        for (auto &c : cases) {
+            std::cout << c.name << std::endl;
+        }
+        return 0;
+    }
+
+    juce::Array<juce::var> results;
+    for (size_t i = 0; i < cases.size(); i++) {
+        std::cerr << "[" << (i + 1) << "/" << cases.size() << "] " << cases[i].name << std::endl;
+        results.add(runCase(cases[i], options.minTime));
+    }
+
+    auto environment = new juce::DynamicObject();
+    environment->setProperty("version", LIBREARP_VERSION);
+    environment->setProperty("juceVersion", juce::SystemStats::getJUCEVersion());
+    environment->setProperty("os", juce::SystemStats::getOperatingSystemName());
+    environment->setProperty("cpu", juce::SystemStats::getCpuModel());
+    environment->setProperty("cpuCount", juce::SystemStats::getNumCpus());
+#if JUCE_DEBUG
+    environment->setProperty("buildType", "debug");
+#else
+    environment->setProperty("buildType", "release");
+#endif
+    environment->setProperty("sampleRate", SAMPLE_RATE);
+    environment->setProperty("bpm", BPM);
+    environment->setProperty("timestamp", juce::Time::getCurrentTime().toISO8601(true));
+
+    auto root = new juce::DynamicObject();
+    root->setProperty("environment", juce::var(environment));
+    root->setProperty("results", results);
+    auto json = juce::JSON::toString(juce::var(root));
+
+    if (args.containsOption("--output")) {
+        auto outputFile = args.getFileForOption("--output");
+        if (!outputFile.replaceWithText(json)) {
+            juce::ConsoleApplication::fail("Could not write " + outputFile.getFullPathName());
+        }
+    } else {
+        std::cout << json << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+    return juce::ConsoleApplication::invokeCatchingFailures([&] { return run(args); });
+}
@@ -0,0 +1,87 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include "OfflineHost.h"
+
+OfflineHost::OfflineHost(LibreArp &p, double sr, int bs)
+        : processor(p),
+          sampleRate(sr),
+          blockSize(bs),
+          audio(1, bs)
+{
+    info.resetToDefault();
+    info.bpm = 120.0;
+    info.timeSigNumerator = 4;
+    info.timeSigDenominator = 4;
+
+    processor.setPlayHead(this);
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+}
+
+OfflineHost::~OfflineHost() {
+    processor.releaseResources();
+    processor.setPlayHead(nullptr);
+}
+
+bool OfflineHost::getCurrentPosition(CurrentPositionInfo &result) {
+    result = info;
+    return true;
+}
+
+void OfflineHost::setTempo(double bpm) {
+    info.bpm = bpm;
+}
+
+void OfflineHost::setTimeSignature(int numerator, int denominator) {
+    info.timeSigNumerator = numerator;
+    info.timeSigDenominator = denominator;
+}
+
+void OfflineHost::processBlock(juce::MidiBuffer &midi) {
+    info.isPlaying = true;
+    info.timeInSamples = position;
+    info.timeInSeconds = static_cast<double>(position) / sampleRate;
+    info.ppqPosition = samplesToPpq(static_cast<double>(position));
+
+    audio.clear();
+    processor.processBlock(audio, midi);
+    position += blockSize;
+}
+
+void OfflineHost::stop(juce::MidiBuffer &midi) {
+    info.isPlaying = false;
+
+    audio.clear();
+    processor.processBlock(audio, midi);
+}
+
+int64_t OfflineHost::getPosition() const {
+    return position;
+}
+
+int OfflineHost::getBlockSize() const {
+    return blockSize;
+}
+
+double OfflineHost::samplesToPpq(double samples) const {
+    return samples / sampleRate * (info.bpm / 60.0);
+}
+
+double OfflineHost::ppqToSamples(double ppq) const {
+    return ppq * (60.0 / info.bpm) * sampleRate;
+}
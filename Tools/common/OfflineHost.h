@@ -0,0 +1,100 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "LibreArp.h"
+
+/**
+ * Drives a LibreArp processor outside of a plugin host, faster than realtime. Acts as the processor's play head,
+ * simulating a transport that advances by one block with each processed block.
+ */
+class OfflineHost : public juce::AudioPlayHead {
+public:
+
+    /**
+     * Constructs the host and prepares the processor for playback.
+     *
+     * @param processor the processor to drive
+     * @param sampleRate the sample rate, in Hz
+     * @param blockSize the number of samples in a block
+     */
+    OfflineHost(LibreArp &processor, double sampleRate, int blockSize);
+
+    ~OfflineHost() override;
+
+    bool getCurrentPosition(CurrentPositionInfo &result) override;
+
+    /**
+     * Sets the tempo of the transport.
+     *
+     * @param bpm the tempo, in beats per minute
+     */
+    void setTempo(double bpm);
+
+    /**
+     * Sets the time signature reported to the processor.
+     */
+    void setTimeSignature(int numerator, int denominator);
+
+    /**
+     * Processes a block at the current position and advances the transport by one block.
+     *
+     * @param midi the input MIDI messages of the block; replaced by the output MIDI messages
+     */
+    void processBlock(juce::MidiBuffer &midi);
+
+    /**
+     * Processes a block with the transport stopped, which makes the processor send note-offs for all its playing
+     * notes. Does not advance the transport.
+     *
+     * @param midi the input MIDI messages of the block; replaced by the output MIDI messages
+     */
+    void stop(juce::MidiBuffer &midi);
+
+    /**
+     * @return the current position of the transport, in samples
+     */
+    int64_t getPosition() const;
+
+    /**
+     * @return the number of samples in a block
+     */
+    int getBlockSize() const;
+
+    /**
+     * Converts the specified number of samples into quarter notes, at the current tempo.
+     */
+    double samplesToPpq(double samples) const;
+
+    /**
+     * Converts the specified number of quarter notes into samples, at the current tempo.
+     */
+    double ppqToSamples(double ppq) const;
+
+private:
+
+    LibreArp &processor;
+    double sampleRate;
+    int blockSize;
+
+    juce::AudioBuffer<float> audio;
+    CurrentPositionInfo info;
+    int64_t position = 0;
+};
@@ -0,0 +1,382 @@
+//
+// This file is part of LibreArp
+//
+// LibreArp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// LibreArp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see https://librearp.gitlab.io/license/.
+//
+
+#include <cmath>
+#include <iostream>
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "OfflineHost.h"
+
+/*
+ * LibreArpRender - renders LibreArp patterns into MIDI files without a plugin host.
+ *
+ * The input chords are read from a Standard MIDI File and fed through the same processor as in the plugin, block by
+ * block, faster than realtime. Both the preset and the input may be directories, in which case every combination of
+ * the contained presets and MIDI files is rendered into the output directory.
+ */
+
+static const char *const USAGE =
+        "Usage: LibreArpRender --preset=<file|dir> --input=<file|dir> --output=<file|dir> [options]\n"
+        "\n"
+        "Renders LibreArp patterns (.lapreset) played with the chords from a MIDI file into a MIDI file.\n"
+        "\n"
+        "Options:\n"
+        "  --bpm=<tempo>               tempo (default: from the input file, or 120; required if the tempo changes)\n"
+        "  --time-sig=<num/den>        time signature (default: from the input file, or 4/4; required if it changes)\n"
+        "  --sample-rate=<Hz>          simulated sample rate (default: 48000)\n"
+        "  --block-size=<samples>      simulated block size (default: 512)\n"
+        "  --tail=<beats>              time rendered after the last input event (default: 4)\n"
+        "  --octaves=<on|off>          octave transposition (default: on)\n"
+        "  --smart-octaves=<on|off>    smart octaves (default: on)\n"
+        "  --input-velocity=<on|off>   use input note velocity (default: on)\n"
+        "  --swing=<0..1>              swing amount (default: 0)\n"
+        "  --chord-size=<0..16>        chord size, 0 is auto (default: 0)\n"
+        "  --note-selection=<bottom|top>  note selection mode (default: bottom)\n"
+        "  --loop-reset=<beats>        reset the pattern every n beats, 0 is never (default: 0)\n"
+        "  --input-channel=<0..16>     MIDI input channel, 0 is any (default: 0)\n"
+        "  --output-channel=<1..16>    MIDI output channel (default: 1)\n";
+
+static const int OUTPUT_TICKS_PER_QUARTER_NOTE = 960;
+
+/**
+ * Behaviour settings applied to each rendered processor.
+ */
+struct RenderSettings {
+    double bpm = 0.0;
+    int timeSigNumerator = 0;
+    int timeSigDenominator = 0;
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    double tailBeats = 4.0;
+
+    bool octaves = true;
+    bool smartOctaves = true;
+    bool usingInputVelocity = true;
+    float swing = 0.0f;
+    int maxChordSize = 0;
+    LibreArp::ExtraNotesSelectionMode extraNotesSelectionMode = LibreArp::FROM_BOTTOM;
+    double loopReset = 0.0;
+    int inputMidiChannel = 0;
+    int outputMidiChannel = 1;
+};
+
+/**
+ * Input chords read from a MIDI file.
+ */
+struct RenderInput {
+    /**
+     * The channel messages of all tracks, timestamped in quarter notes.
+     */
+    juce::MidiMessageSequence messages;
+
+    double bpm = 120.0;
+    int timeSigNumerator = 4;
+    int timeSigDenominator = 4;
+
+    /**
+     * Whether the tempo or the time signature change within the file. Only a constant tempo and time signature can
+     * be rendered.
+     */
+    bool hasTempoChanges = false;
+    bool hasTimeSigChanges = false;
+};
+
+
+static bool parseSwitch(const juce::ArgumentList &args, const juce::String &option, bool defaultValue) {
+    if (!args.containsOption(option)) {
+        return defaultValue;
+    }
+
+    auto value = args.getValueForOption(option).toLowerCase();
+    if (value == "on" || value == "true" || value == "1") return true;
+    if (value == "off" || value == "false" || value == "0") return false;
+
+    juce::ConsoleApplication::fail("Invalid value of " + option + ": " + value);
+    return defaultValue;
+}
+
+static double parseNumber(const juce::ArgumentList &args, const juce::String &option,
+                          double defaultValue, double min, double max) {
+    if (!args.containsOption(option)) {
+        return defaultValue;
+    }
+
+    auto text = args.getValueForOption(option);
+    auto value = text.getDoubleValue();
+    if (!text.containsOnly("0123456789.-") || value < min || value > max) {
+        juce::ConsoleApplication::fail("Invalid value of " + option + ": " + text);
+    }
+    return value;
+}
+
+static RenderSettings parseSettings(const juce::ArgumentList &args) {
+    RenderSettings settings;
+
+    settings.bpm = parseNumber(args, "--bpm", 0.0, 1.0, 999.0);
+    if (args.containsOption("--time-sig")) {
+        auto text = args.getValueForOption("--time-sig");
+        settings.timeSigNumerator = text.upToFirstOccurrenceOf("/", false, false).getIntValue();
+        settings.timeSigDenominator = text.fromFirstOccurrenceOf("/", false, false).getIntValue();
+        if (settings.timeSigNumerator <= 0 || settings.timeSigDenominator <= 0) {
+            juce::ConsoleApplication::fail("Invalid value of --time-sig: " + text);
+        }
+    }
+    settings.sampleRate = parseNumber(args, "--sample-rate", settings.sampleRate, 1000.0, 768000.0);
+    settings.blockSize = static_cast<int>(parseNumber(args, "--block-size", settings.blockSize, 1, 1 << 20));
+    settings.tailBeats = parseNumber(args, "--tail", settings.tailBeats, 0.0, 65535.0);
+
+    settings.octaves = parseSwitch(args, "--octaves", settings.octaves);
+    settings.smartOctaves = parseSwitch(args, "--smart-octaves", settings.smartOctaves);
+    settings.usingInputVelocity = parseSwitch(args, "--input-velocity", settings.usingInputVelocity);
+    settings.swing = static_cast<float>(parseNumber(args, "--swing", settings.swing, 0.0, 1.0));
+    settings.maxChordSize = static_cast<int>(parseNumber(args, "--chord-size", settings.maxChordSize, 0, 16));
+    if (args.containsOption("--note-selection")) {
+        auto value = args.getValueForOption("--note-selection").toLowerCase();
+        if (value == "bottom") {
+            settings.extraNotesSelectionMode = LibreArp::FROM_BOTTOM;
+        } else if (value == "top") {
+            settings.extraNotesSelectionMode = LibreArp::FROM_TOP;
+        } else {
+            juce::ConsoleApplication::fail("Invalid value of --note-selection: " + value);
+        }
+    }
+    settings.loopReset = parseNumber(args, "--loop-reset", settings.loopReset, 0.0, 65535.0);
+    settings.inputMidiChannel = static_cast<int>(parseNumber(args, "--input-channel", settings.inputMidiChannel, 0, 16));
+    settings.outputMidiChannel = static_cast<int>(parseNumber(args, "--output-channel", settings.outputMidiChannel, 1, 16));
+
+    return settings;
+}
+
+static RenderInput readInput(const juce::File &file) {
+    juce::FileInputStream stream(file);
+    juce::MidiFile midiFile;
+    if (!stream.openedOk() || !midiFile.readFrom(stream)) {
+        juce::ConsoleApplication::fail("Could not read MIDI file " + file.getFullPathName());
+    }
+
+    auto ticksPerQuarterNote = midiFile.getTimeFormat();
+    if (ticksPerQuarterNote <= 0) {
+        juce::ConsoleApplication::fail("SMPTE time format is not supported: " + file.getFullPathName());
+    }
+
+    RenderInput result;
+
+    // Events after the start that differ from the tempo or time signature in effect (the defaults of 120 BPM and 4/4
+    // before the first event) are changes
+    juce::MidiMessageSequence tempoEvents;
+    midiFile.findAllTempoEvents(tempoEvents);
+    for (int i = 0; i < tempoEvents.getNumEvents(); i++) {
+        auto &message = tempoEvents.getEventPointer(i)->message;
+        auto secondsPerQuarterNote = message.getTempoSecondsPerQuarterNote();
+        if (secondsPerQuarterNote <= 0.0) {
+            continue;
+        }
+
+        auto bpm = 60.0 / secondsPerQuarterNote;
+        if (message.getTimeStamp() > 0.0 && std::abs(bpm - result.bpm) > 1e-6) {
+            result.hasTempoChanges = true;
+        }
+        result.bpm = bpm;
+    }
+
+    juce::MidiMessageSequence timeSigEvents;
+    midiFile.findAllTimeSigEvents(timeSigEvents);
+    for (int i = 0; i < timeSigEvents.getNumEvents(); i++) {
+        auto &message = timeSigEvents.getEventPointer(i)->message;
+        int numerator;
+        int denominator;
+        message.getTimeSignatureInfo(numerator, denominator);
+        if (message.getTimeStamp() > 0.0
+                && (numerator != result.timeSigNumerator || denominator != result.timeSigDenominator)) {
+            result.hasTimeSigChanges = true;
+        }
+        result.timeSigNumerator = numerator;
+        result.timeSigDenominator = denominator;
+    }
+
+    for (int trackIndex = 0; trackIndex < midiFile.getNumTracks(); trackIndex++) {
+        auto track = midiFile.getTrack(trackIndex);
+        for (auto event : *track) {
+            auto &message = event->message;
+            if (message.isMetaEvent() || message.isSysEx()) {
+                continue;
+            }
+
+            juce::MidiMessage copy(message);
+            copy.setTimeStamp(message.getTimeStamp() / ticksPerQuarterNote);
+            result.messages.addEvent(copy);
+        }
+    }
+    result.messages.sort();
+
+    return result;
+}
+
+static void render(const juce::File &presetFile,
+                   const RenderInput &input,
+                   const RenderSettings &settings,
+                   const juce::File &outputFile) {
+    LibreArp processor(false);
+    processor.setNonPlayingModeOverride(NonPlayingMode::Value::SILENCE);
+    processor.setTransposingOctaves(settings.octaves);
+    processor.setUsingSmartOctaves(settings.smartOctaves);
+    processor.setUsingInputVelocity(settings.usingInputVelocity);
+    processor.setSwing(settings.swing);
+    processor.setMaxChordSize(settings.maxChordSize);
+    processor.setExtraNotesSelectionMode(settings.extraNotesSelectionMode);
+    processor.setLoopReset(settings.loopReset);
+    processor.setInputMidiChannel(settings.inputMidiChannel);
+    processor.setOutputMidiChannel(settings.outputMidiChannel);
+    processor.loadPatternFromFile(presetFile);
+
+    auto bpm = (settings.bpm > 0.0) ? settings.bpm : input.bpm;
+    auto timeSigNumerator = (settings.timeSigNumerator > 0) ? settings.timeSigNumerator : input.timeSigNumerator;
+    auto timeSigDenominator = (settings.timeSigDenominator > 0) ? settings.timeSigDenominator : input.timeSigDenominator;
+
+    OfflineHost host(processor, settings.sampleRate, settings.blockSize);
+    host.setTempo(bpm);
+    host.setTimeSignature(timeSigNumerator, timeSigDenominator);
+
+    auto &messages = input.messages;
+    auto endPpq = messages.getEndTime() + settings.tailBeats;
+    auto endSample = static_cast<int64_t>(std::ceil(host.ppqToSamples(endPpq)));
+
+    juce::MidiMessageSequence output;
+    auto addOutput = [&](const juce::MidiBuffer &midi, int64_t blockPosition) {
+        for (const auto metadata : midi) {
+            auto samplePosition = static_cast<double>(blockPosition + metadata.samplePosition);
+            auto ticks = std::round(host.samplesToPpq(samplePosition) * OUTPUT_TICKS_PER_QUARTER_NOTE);
+
+            juce::MidiMessage message = metadata.getMessage();
+            message.setTimeStamp(ticks);
+            output.addEvent(message);
+        }
+    };
+
+    int nextInputIndex = 0;
+    juce::MidiBuffer midi;
+    while (host.getPosition() < endSample) {
+        auto blockPosition = host.getPosition();
+        auto blockEnd = blockPosition + host.getBlockSize();
+
+        midi.clear();
+        for (; nextInputIndex < messages.getNumEvents(); nextInputIndex++) {
+            auto &message = messages.getEventPointer(nextInputIndex)->message;
+            auto samplePosition = static_cast<int64_t>(std::floor(host.ppqToSamples(message.getTimeStamp())));
+            if (samplePosition >= blockEnd) {
+                break;
+            }
+            midi.addEvent(message, static_cast<int>(juce::jmax(int64_t(0), samplePosition - blockPosition)));
+        }
+
+        host.processBlock(midi);
+        addOutput(midi, blockPosition);
+    }
+
+    // Let the processor send note-offs for everything still playing
+    midi.clear();
+    host.stop(midi);
+    addOutput(midi, host.getPosition());
+
+    output.sort();
+    output.updateMatchedPairs();
+
+    juce::MidiMessageSequence meta;
+    meta.addEvent(juce::MidiMessage::tempoMetaEvent(static_cast<int>(std::round(60000000.0 / bpm))));
+    meta.addEvent(juce::MidiMessage::timeSignatureMetaEvent(timeSigNumerator, timeSigDenominator));
+    output.addSequence(meta, 0.0);
+    output.sort();
+
+    juce::MidiFile midiFile;
+    midiFile.setTicksPerQuarterNote(OUTPUT_TICKS_PER_QUARTER_NOTE);
+    midiFile.addTrack(output);
+
+    outputFile.deleteFile();
+    juce::FileOutputStream stream(outputFile);
+    if (!stream.openedOk() || !midiFile.writeTo(stream)) {
+        juce::ConsoleApplication::fail("Could not write MIDI file " + outputFile.getFullPathName());
+    }
+}
+
+static juce::Array<juce::File> listFiles(const juce::File &fileOrDirectory, const juce::String &wildcard) {
+    juce::Array<juce::File> result;
+    if (fileOrDirectory.isDirectory()) {
+        result = fileOrDirectory.findChildFiles(juce::File::findFiles, false, wildcard);
+        result.sort();
+    } else if (fileOrDirectory.existsAsFile()) {
+        result.add(fileOrDirectory);
+    } else {
+        juce::ConsoleApplication::fail("No such file or directory: " + fileOrDirectory.getFullPathName());
+    }
+    return result;
+}
+
+static int run(juce::ArgumentList args) {
+    if (args.containsOption("--help|-h") || args.size() == 0) {
+        std::cout << USAGE;
+        return 0;
+    }
+
+    args.failIfOptionIsMissing("--preset");
+    args.failIfOptionIsMissing("--input");
+    args.failIfOptionIsMissing("--output");
+
+    auto presetArg = args.getExistingFileForOptionAndRemove("--preset");
+    auto inputArg = args.getExistingFileForOptionAndRemove("--input");
+    auto outputArg = args.getFileForOptionAndRemove("--output");
+    auto settings = parseSettings(args);
+
+    auto presetFiles = listFiles(presetArg, "*.lapreset");
+    auto inputFiles = listFiles(inputArg, "*.mid;*.midi");
+    bool batch = presetArg.isDirectory() || inputArg.isDirectory();
+
+    if (batch && !outputArg.isDirectory() && !outputArg.createDirectory()) {
+        juce::ConsoleApplication::fail("Could not create output directory " + outputArg.getFullPathName());
+    }
+
+    for (auto &inputFile : inputFiles) {
+        auto input = readInput(inputFile);
+        if (input.hasTempoChanges && settings.bpm <= 0.0) {
+            juce::ConsoleApplication::fail("Tempo changes are not supported, use --bpm to render at a constant tempo: "
+                                           + inputFile.getFullPathName());
+        }
+        if (input.hasTimeSigChanges && settings.timeSigNumerator <= 0) {
+            juce::ConsoleApplication::fail("Time signature changes are not supported, use --time-sig to render with "
+                                           "a constant time signature: " + inputFile.getFullPathName());
+        }
+
+        for (auto &presetFile : presetFiles) {
+            auto outputFile = (batch)
+                    ? outputArg.getChildFile(presetFile.getFileNameWithoutExtension()
+                            + "_" + inputFile.getFileNameWithoutExtension() + ".mid")
+                    : outputArg;
+
+            std::cout << presetFile.getFileName() << " + " << inputFile.getFileName()
+                      << " -> " << outputFile.getFullPathName() << std::endl;
+            render(presetFile, input, settings, outputFile);
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+    return juce::ConsoleApplication::invokeCatchingFailures([&] { return run(args); });
+}